@@ -0,0 +1,102 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "hash_reversal/batch_kernels.hpp"
+#include "hash_reversal/inference_tool.hpp"
+
+namespace hash_reversal {
+
+/*
+ * Loopy BP on a batch of samples in lockstep. All samples share the topology
+ * of the circuit and only differ in which RVs are observed, so every message
+ * holds one value per sample ("lane") and each node update reads the graph
+ * once for all lanes. The updates run as AVX-512 or AVX2 vectors of lanes
+ * when the CPU supports them, see `BatchKernels`.
+ *
+ * Each lane follows the serial schedule of `FactorGraph` and stops updating
+ * once it converges, so its marginals are exactly those of solving the sample
+ * on its own with `method: "lbp"`.
+ */
+class BatchFactorGraph : public InferenceTool {
+ public:
+  BatchFactorGraph(std::shared_ptr<Probability> prob, std::shared_ptr<Dataset> dataset,
+                   std::shared_ptr<utils::Config> config,
+                   std::shared_ptr<const Topology> graph);
+
+  //! Starts a new batch with one lane per set of observed RVs
+  void reconfigure(const std::vector<VariableAssignments> &observed);
+
+  void solve() override;
+
+  //! Marginals of the first lane
+  std::vector<InferenceTool::Prediction> marginals() const override;
+
+  std::vector<InferenceTool::Prediction> marginals(size_t lane) const;
+
+  size_t memoryBytes() const override;
+
+  //! Samples in the current batch
+  size_t numLanes() const { return num_lanes_; }
+
+  //! Iterations of each lane in the last solve()
+  const std::vector<size_t> &iterations() const { return iterations_; }
+
+  const BatchKernels &kernels() const { return kernels_; }
+
+  //! Replaces the kernels, which must be supported by the CPU
+  void setKernels(const BatchKernels &kernels) { kernels_ = kernels; }
+
+ protected:
+  //! Starts a batch of one sample
+  void reconfigure(const VariableAssignments &observed) override;
+
+ private:
+  Prediction predict(size_t v, size_t lane) const;
+
+  BatchKernels kernels_;
+
+  //! RV offsets and edge RVs of the graph as plain arrays for the kernels
+  std::vector<size_t> rv_offsets_, edge_rvs_;
+
+  //! Output edge of every factor, grouped by factor type
+  std::vector<std::vector<size_t>> first_edges_;
+  std::vector<BatchFactors> factors_;
+
+  size_t num_lanes_;
+
+  //! Lanes of the buffers, `num_lanes_` rounded up to whole chunks
+  size_t stride_;
+
+  //! Factor -> RV messages, indexed [(2 * edge + value) * stride_ + lane]
+  std::vector<double> factor_msgs_;
+
+  //! RV -> factor messages, indexed like `factor_msgs_`
+  std::vector<double> rv_msgs_;
+
+  //! Lanes in which each RV is observed as 0 or 1, see `BatchSweep`
+  std::vector<uint8_t> observed_lanes_;
+
+  //! Lanes which have not converged yet, one bit per lane
+  std::vector<uint8_t> active_;
+
+  std::vector<double> deltas_;
+  std::vector<size_t> iterations_;
+  bool first_sweep_;
+};
+
+}  // end namespace hash_reversal
@@ -0,0 +1,247 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "hash_reversal/factor.hpp"
+#include "hash_reversal/factor_kernels.hpp"
+
+namespace hash_reversal {
+
+/*
+ * Message sweeps of `BatchFactorGraph` over every lane of a batch at once.
+ *
+ * The lanes of a batch are padded to whole chunks of `kChunkLanes`, and flags
+ * per lane are stored as one bit per lane, one byte per chunk. Each message
+ * buffer holds `num_lanes` consecutive values per edge and RV value, indexed
+ * [(2 * edge + value) * num_lanes + lane], so one node update loads whole
+ * vectors of lanes.
+ *
+ * The sweeps are compiled once per instruction set, in batch_kernels.cpp
+ * (scalar), batch_kernels_avx2.cpp and batch_kernels_avx512.cpp, and picked
+ * at runtime. Those files only see the plain arrays of `BatchSweep`, so no
+ * inline function compiled for a wider instruction set can be linked into
+ * code which runs on any CPU.
+ */
+
+constexpr size_t kChunkLanes = 8;
+
+//! Factors of one type, updated together
+struct BatchFactors {
+  FactorType type;
+  size_t size;
+  //! Edge ID of the output RV of each factor, its inputs follow
+  const size_t *first_edges;
+  //! probOne() tables of the type when the output RV is unobserved, observed as 0 and as 1
+  const double *table, *table_zero, *table_one;
+};
+
+//! Graph, observations and messages of a batch
+struct BatchSweep {
+  //! Lanes of every buffer, a multiple of `kChunkLanes`
+  size_t num_lanes;
+  size_t num_rvs;
+  //! Edges of RV `v` are `rv_edges[rv_offsets[v]]` to `rv_edges[rv_offsets[v + 1] - 1]`
+  const size_t *rv_offsets;
+  const size_t *rv_edges;
+  //! Dense RV ID of each edge
+  const size_t *edge_rvs;
+  const BatchFactors *factors;
+  size_t num_factor_types;
+  //! Lanes in which RV `v` is observed as `value`, indexed [(2 * v + value) * chunks + chunk]
+  const uint8_t *observed;
+  //! Lanes which have not converged yet, indexed by chunk
+  const uint8_t *active;
+  double damping;
+  //! The first sweep overwrites the initial messages instead of damping them
+  bool first_sweep;
+  //! Factor -> RV and RV -> factor messages
+  double *factor_msgs;
+  double *rv_msgs;
+  //! Largest change of P(RV = 1) of any factor -> RV message per lane, or
+  //  infinity if a message of the lane was all zeros or not finite
+  double *deltas;
+};
+
+//! Both half sweeps of one LBP iteration, compiled for one instruction set
+struct BatchKernels {
+  const char *name;
+  void (*updateRandomVariables)(const BatchSweep &sweep);
+  void (*updateFactors)(const BatchSweep &sweep);
+};
+
+BatchKernels scalarBatchKernels();
+BatchKernels avx2BatchKernels();
+BatchKernels avx512BatchKernels();
+
+//! Kernels which the CPU can run, widest first. The scalar kernels are always last.
+std::vector<BatchKernels> supportedBatchKernels();
+
+/*
+ * The sweeps, for a vector type `V` of `V::kWidth` lanes which divides
+ * `kChunkLanes`. They do the same arithmetic as the serial schedule of
+ * `FactorGraph` in the same order. Within each half sweep every node only
+ * reads messages of the other half, so the order of the nodes does not
+ * change the result either.
+ */
+namespace batch {
+
+//! `FactorGraph::updateMessage()` on the lanes of `msg`, returns the lanes which were invalid
+template <class V>
+inline typename V::Mask updateMessage(const BatchSweep &s, double *msg, V msg0, V msg1,
+                                      typename V::Mask active, V &delta) {
+  const size_t lanes = s.num_lanes;
+  const V prev0 = V::load(msg), prev1 = V::load(msg + lanes);
+  const V sum = msg0 + msg1;
+  const typename V::Mask valid = V::positiveFinite(sum);
+  msg0 = msg0 / sum;
+  msg1 = msg1 / sum;
+
+  const V prev_sum = prev0 + prev1;
+  const V prev_p = prev1 / prev_sum;
+  V next0 = msg0, next1 = msg1;
+  if (!s.first_sweep) {
+    const V damping = V::set1(s.damping), keep = V::set1(1.0 - s.damping);
+    next0 = damping * msg0 + keep * prev0 / prev_sum;
+    next1 = damping * msg1 + keep * prev1 / prev_sum;
+  }
+
+  // Invalid lanes keep the previous message, converged lanes all of theirs
+  const typename V::Mask update = valid & active;
+  V::select(update, next0, prev0).store(msg);
+  V::select(update, next1, prev1).store(msg + lanes);
+  delta = V::select(valid, V::abs(next1 - prev_p), V::set1(V::infinity()));
+  return active & ~valid;
+}
+
+template <class V>
+void updateRandomVariables(const BatchSweep &s) {
+  const size_t lanes = s.num_lanes;
+  const size_t num_chunks = lanes / kChunkLanes;
+
+  for (size_t v = 0; v < s.num_rvs; ++v) {
+    const size_t begin = s.rv_offsets[v];
+    const size_t end = s.rv_offsets[v + 1];
+    for (size_t i = begin; i < end; ++i) {
+      double *msg = s.rv_msgs + 2 * s.rv_edges[i] * lanes;
+      for (size_t c = 0; c < num_chunks; ++c) {
+        for (size_t k = 0; k < kChunkLanes; k += V::kWidth) {
+          const size_t lane = c * kChunkLanes + k;
+          V result0 = V::set1(1.0), result1 = V::set1(1.0);
+          for (size_t j = begin; j < end; ++j) {
+            if (i == j) continue;
+            const double *in = s.factor_msgs + 2 * s.rv_edges[j] * lanes + lane;
+            result0 = result0 * V::load(in);
+            result1 = result1 * V::load(in + lanes);
+          }
+          // Only invalid RV -> factor messages count, convergence is decided
+          // from the factor -> RV messages
+          V delta;
+          const typename V::Mask invalid = updateMessage(
+              s, msg + lane, result0, result1, V::mask(s.active[c], k), delta);
+          const V deltas = V::load(s.deltas + lane);
+          V::select(invalid, V::set1(V::infinity()), deltas).store(s.deltas + lane);
+        }
+      }
+    }
+  }
+}
+
+template <class V, size_t N>
+void updateFactors(const BatchSweep &s, const BatchFactors &factors) {
+  const size_t lanes = s.num_lanes;
+  const size_t num_chunks = lanes / kChunkLanes;
+
+  for (size_t idx = 0; idx < factors.size; ++idx) {
+    const size_t begin = factors.first_edges[idx];
+    const uint8_t *observed[N];
+    for (size_t i = 0; i < N; ++i) {
+      observed[i] = s.observed + 2 * s.edge_rvs[begin + i] * num_chunks;
+    }
+
+    for (size_t c = 0; c < num_chunks; ++c) {
+      const uint8_t out_zero = observed[0][c], out_one = observed[0][num_chunks + c];
+      for (size_t k = 0; k < kChunkLanes; k += V::kWidth) {
+        const size_t lane = c * kChunkLanes + k;
+
+        // Each lane's table depends on the observation of the output RV
+        V t[8];
+        if ((out_zero | out_one) == 0) {
+          for (size_t i = 0; i < 8; ++i) t[i] = V::set1(factors.table[i]);
+        } else {
+          const typename V::Mask is_zero = V::mask(out_zero, k), is_one = V::mask(out_one, k);
+          for (size_t i = 0; i < 8; ++i) {
+            t[i] = V::select(is_one, V::set1(factors.table_one[i]),
+                             V::select(is_zero, V::set1(factors.table_zero[i]),
+                                       V::set1(factors.table[i])));
+          }
+        }
+
+        // Observed RVs only contribute their message for the observed value
+        kernels::Pair<V> in[N], out[N];
+        for (size_t i = 0; i < N; ++i) {
+          const double *msg = s.rv_msgs + 2 * (begin + i) * lanes + lane;
+          const V zero = V::set1(0.0);
+          in[i] = {V::select(V::mask(observed[i][num_chunks + c], k), zero, V::load(msg)),
+                   V::select(V::mask(observed[i][c], k), zero, V::load(msg + lanes))};
+        }
+
+        if constexpr (N == 3) {
+          kernels::andMessages(t, in, out);
+        } else if constexpr (N == 2) {
+          kernels::unaryMessages(t, in, out);
+        } else {
+          kernels::priorMessages(t, out);
+        }
+
+        const typename V::Mask active = V::mask(s.active[c], k);
+        V max_delta = V::load(s.deltas + lane);
+        for (size_t i = 0; i < N; ++i) {
+          V delta;
+          updateMessage(s, s.factor_msgs + 2 * (begin + i) * lanes + lane, out[i][0], out[i][1],
+                        active, delta);
+          max_delta = V::max(max_delta, delta);
+        }
+        max_delta.store(s.deltas + lane);
+      }
+    }
+  }
+}
+
+template <class V>
+void updateFactors(const BatchSweep &s) {
+  for (size_t i = 0; i < s.num_factor_types; ++i) {
+    const BatchFactors &factors = s.factors[i];
+    switch (factors.type) {
+      case FactorType::AND:
+        updateFactors<V, 3>(s, factors);
+        break;
+      case FactorType::INV:
+      case FactorType::SAME:
+        updateFactors<V, 2>(s, factors);
+        break;
+      case FactorType::PRIOR:
+        updateFactors<V, 1>(s, factors);
+        break;
+      case FactorType::UNSUPPORTED:
+        break;
+    }
+  }
+}
+
+}  // end namespace batch
+
+}  // end namespace hash_reversal
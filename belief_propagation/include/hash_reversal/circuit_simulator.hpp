@@ -0,0 +1,63 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "hash_reversal/factor.hpp"
+#include "hash_reversal/topology.hpp"
+
+namespace hash_reversal {
+
+/*
+ * Bitsliced evaluator of the hash circuit. The factors are compiled into a
+ * flat list of instructions in topological order, and every RV is evaluated
+ * for many input assignments at once with word-wide bit operations.
+ *
+ * RV values are stored as `num_words` consecutive 64-bit words per dense RV,
+ * so one pass evaluates 64 * num_words assignments. Bit `k` of word `w` of an
+ * RV is its value in assignment `64 * w + k`. The loops over the words of an
+ * instruction are vectorized by the compiler, so several words per RV make use
+ * of AVX2 / AVX-512 registers.
+ */
+class CircuitSimulator {
+ public:
+  explicit CircuitSimulator(std::shared_ptr<const Topology> graph);
+
+  const Topology &graph() const { return *graph_; }
+
+  //! Dense IDs of the RVs with a PRIOR factor, which are the circuit inputs
+  const std::vector<size_t> &inputs() const { return inputs_; }
+
+  size_t numInstructions() const { return instructions_.size(); }
+
+  /*
+   * Evaluates the circuit in place. `words` holds `num_words` words per dense
+   * RV, indexed [v * num_words + w], and the words of inputs() must be set.
+   */
+  void evaluate(uint64_t *words, size_t num_words) const;
+
+ private:
+  struct Instruction {
+    FactorType type;
+    uint32_t out, in1, in2;
+  };
+
+  std::shared_ptr<const Topology> graph_;
+  std::vector<size_t> inputs_;
+  std::vector<Instruction> instructions_;
+};
+
+}  // end namespace hash_reversal
@@ -0,0 +1,66 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "hash_reversal/dataset.hpp"
+
+namespace hash_reversal {
+
+/*
+ * Column-major copy of some RVs of a range of samples. The values of each RV
+ * across the samples are one contiguous bitvector, where bit `k` of word `w`
+ * is its value in sample `64 * w + k` of the range. Only the requested RVs are
+ * kept, e.g. the hash inputs or the observed bits, and per-RV statistics over
+ * all samples are popcounts of the bitvectors.
+ */
+class ColumnStore {
+ public:
+  //! Loads the columns of `rv_indices` for the samples [begin, end) of `dataset`
+  ColumnStore(const Dataset &dataset, const std::vector<size_t> &rv_indices, size_t begin,
+              size_t end);
+
+  size_t numSamples() const { return num_samples_; }
+
+  //! Number of words of each column
+  size_t numWords() const { return num_words_; }
+
+  bool contains(size_t rv_index) const;
+
+  //! Bitvector of an RV, which must be one of the loaded columns
+  const uint64_t *column(size_t rv_index) const;
+
+  //! Value of an RV in sample `sample` of the range, the RV must be a loaded column
+  bool value(size_t rv_index, size_t sample) const {
+    return (column(rv_index)[sample / 64] >> (sample % 64)) & 1;
+  }
+
+  //! Number of samples in which the RV is 1
+  size_t countOnes(size_t rv_index) const;
+
+ private:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  size_t num_samples_;
+  size_t num_words_;
+
+  //! Column of each RV index, or npos if it was not loaded
+  std::vector<size_t> columns_;
+
+  //! Column `c` is stored at [c * num_words_, (c + 1) * num_words_)
+  std::vector<uint64_t> bits_;
+};
+
+}  // end namespace hash_reversal
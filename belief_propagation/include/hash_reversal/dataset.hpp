@@ -13,25 +13,63 @@
 #pragma once
 
 #include <boost/dynamic_bitset.hpp>
+#include <future>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "hash_reversal/circuit_simulator.hpp"
 #include "hash_reversal/factor.hpp"
+#include "hash_reversal/sample_view.hpp"
+#include "hash_reversal/topology.hpp"
 #include "hash_reversal/variable_assignments.hpp"
 #include "utils/config.hpp"
 #include "utils/convenience.hpp"
 
 namespace hash_reversal {
 
+class ColumnStore;
+
 class Dataset {
  public:
   explicit Dataset(std::shared_ptr<utils::Config> config);
 
-  typedef std::pair<std::map<size_t, RandomVariable>, std::map<size_t, Factor>> Graph;
-  Graph loadFactorGraph() const;
+  ~Dataset();
+
+  Dataset(const Dataset &) = delete;
+  Dataset &operator=(const Dataset &) = delete;
+
+  Topology loadFactorGraph() const;
+
+  /*
+   * Loads a `factors.txt` file without needing a full algorithm config. The
+   * parsed graph is cached in binary form next to it (`factors.bin`), which
+   * later runs load instead as long as the text has not changed.
+   */
+  static Topology loadFactorGraph(const std::string &graph_file);
+
+  //! Parses `graph_file` and writes it in binary form to `binary_file`
+  static bool convertFactorGraph(const std::string &graph_file, const std::string &binary_file);
+
+  /*
+   * Number of samples selected by `sample_offset` and `sample_stride`. The
+   * sample indices below count the selected samples only.
+   */
+  size_t numSamples() const;
+
+  /*
+   * Bytes of the samples owned by the process: the realigned samples, or the
+   * windows read so far in streaming mode. The mapped data file is not
+   * included, see `mappedBytes()`.
+   */
+  size_t memoryBytes() const;
+
+  //! Bytes of `data.bits` mapped in place. The pages are file-backed and reclaimable.
+  size_t mappedBytes() const;
 
   bool isHashInputBit(size_t bit_index) const;
 
@@ -39,13 +77,82 @@ class Dataset {
 
   VariableAssignments getObservedData(size_t sample_index) const;
 
-  boost::dynamic_bitset<> getFullSample(size_t sample_index) const;
+  /*
+   * Observed bits of sample `sample_index`, read from `columns`. The columns
+   * must hold the observed RVs of a range of samples which starts at
+   * `first_sample`.
+   */
+  VariableAssignments getObservedData(const ColumnStore &columns, size_t first_sample,
+                                      size_t sample_index) const;
+
+  /*
+   * View of all bits of a sample, valid as long as the dataset exists. In
+   * streaming mode the view keeps the window of samples it points to alive.
+   */
+  SampleView getFullSample(size_t sample_index) const;
+
+  /*
+   * Whether every circuit input is a hash input bit. Otherwise the predicted
+   * input does not determine the circuit, and validate() rejects every
+   * prediction.
+   */
+  bool canValidate(const CircuitSimulator &simulator) const;
 
-  bool validate(const boost::dynamic_bitset<> predicted_input, size_t sample_index) const;
+  /*
+   * Evaluates the circuit on the predicted hash input and checks that it
+   * reproduces the observed bits of the sample. Observed bits which were
+   * pruned from the factor graph are not compared.
+   */
+  bool validate(const CircuitSimulator &simulator, const boost::dynamic_bitset<> predicted_input,
+                size_t sample_index) const;
 
  private:
+  static Topology parseFactorGraph(const std::string &text);
+
+  static std::vector<Factor> parseFactors(const std::string &text, size_t begin, size_t end);
+
+  typedef std::shared_ptr<const std::vector<uint64_t>> Window;
+
+  size_t sampleIndexInFile(size_t sample_index) const;
+
+  Window readWindow(size_t window) const;
+
+  Window getWindow(size_t window) const;
+
   std::shared_ptr<utils::Config> config_;
-  std::vector<boost::dynamic_bitset<>> samples_;
+
+  //! Number of samples selected from the data file
+  size_t num_selected_;
+
+  //! Memory-mapped `data.bits`, if the samples are used from it in place
+  void *mapped_;
+  size_t mapped_size_;
+
+  //! Selected samples realigned to word boundaries, if not used in place
+  std::vector<uint64_t> buffer_;
+
+  //! First row and the distance between consecutive rows in bytes
+  const unsigned char *samples_;
+  size_t row_bytes_;
+
+  //! Whether rows are the samples of the file, or only the selected ones
+  bool in_place_;
+
+  //! Data file read from in streaming mode
+  int fd_;
+  size_t file_size_;
+
+  //! Selected samples per window, and how many windows are kept in memory
+  size_t window_samples_;
+  size_t max_windows_;
+
+  //! Windows that were read or are being read ahead, most recently used first
+  mutable std::mutex windows_mutex_;
+  mutable std::list<std::pair<size_t, std::shared_future<Window>>> windows_;
+
+  //! Evicted windows which were still being read. Destroying the last copy of
+  //  a future from std::async waits for it, so they are kept until ready.
+  mutable std::list<std::shared_future<Window>> pending_evicted_;
 };
 
 }  // end namespace hash_reversal
\ No newline at end of file
@@ -12,64 +12,38 @@
 
 #pragma once
 
-#include <map>
-#include <memory>
+#include <cstdint>
 #include <set>
 #include <string>
-#include <utility>
-
-#include "hash_reversal/variable_assignments.hpp"
-#include "utils/config.hpp"
+#include <vector>
 
 namespace hash_reversal {
 
-/*****************************************
- *********** FACTOR GRAPH NODE ***********
- *****************************************/
-
-class FactorGraphNode {
- public:
-  virtual ~FactorGraphNode();
-
-  void updateMessage(size_t to, bool rv_val, double new_msg,
-                     std::shared_ptr<utils::Config> config);
-
-  double prevMessage(size_t to, bool rv_val) const;
-
-  void reset();
-
- protected:
-  std::map<std::pair<size_t, double>, double> messages_;
-};
-
-/*****************************************
- ************ RANDOM VARIABLE ************
- *****************************************/
-
-class RandomVariable : public FactorGraphNode {
- public:
-  std::set<size_t> factor_indices;
-};
+//! Factor types are resolved from their name once, when the graph is loaded
+enum class FactorType : uint8_t { PRIOR, INV, SAME, AND, UNSUPPORTED };
 
 /*****************************************
  **************** FACTOR *****************
  *****************************************/
 
-class Factor : public FactorGraphNode {
+class Factor {
  public:
-  struct Values {
-    bool in1, in2, out;
-  };
-
   Factor();
 
   Factor(const std::string &ftype, size_t out, const std::set<size_t> &ref);
 
-  Values extract(const VariableAssignments &assignments) const;
+  static FactorType parseType(const std::string &ftype);
+
+  //! Number of RVs a factor of `type` references, its output included, 0 if unsupported
+  static size_t numRVs(FactorType type);
+
+  //! Most RVs of any supported factor type, which sizes the per-factor message buffers
+  static constexpr size_t kMaxRVs = 3;
 
   std::vector<size_t> inputRVs() const;
 
   std::string factor_type;
+  FactorType type;
   size_t output_rv;
   std::set<size_t> referenced_rvs;
 };
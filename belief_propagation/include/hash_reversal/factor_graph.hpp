@@ -12,33 +12,99 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "hash_reversal/inference_tool.hpp"
+#include "utils/indexed_heap.hpp"
+#include "utils/thread_pool.hpp"
 
 namespace hash_reversal {
 
 class FactorGraph : public InferenceTool {
  public:
   FactorGraph(std::shared_ptr<Probability> prob, std::shared_ptr<Dataset> dataset,
-              std::shared_ptr<utils::Config> config);
+              std::shared_ptr<utils::Config> config,
+              std::shared_ptr<const Topology> graph);
 
   void solve() override;
 
   std::vector<InferenceTool::Prediction> marginals() const override;
 
+  //! Includes the compacted core graph of the current sample, if any
+  size_t memoryBytes() const override;
+
+  //! Iterations, or sweeps of the residual schedule, of the last solve()
+  size_t iterations() const { return iterations_; }
+
  protected:
   void reconfigure(const VariableAssignments &observed) override;
 
  private:
-  Prediction predict(size_t rv_index) const;
-  void updateFactorMessages(bool forward);
-  void updateRandomVariableMessages(bool forward);
-  bool equal(const std::vector<InferenceTool::Prediction> &marginals1,
-             const std::vector<InferenceTool::Prediction> &marginals2,
-             double tol = 1e-4) const;
-
-  std::vector<InferenceTool::Prediction> previous_marginals_;
+  //! Runs single message sweeps in `hash_reversal_bench`
+  friend class FactorGraphBenchmark;
+
+  void compact();
+  Prediction predict(size_t v) const;
+  double updateMessage(const Message &prev, Message &next, double msg0, double msg1) const;
+  size_t computeFactor(size_t f, const Message *rv_msgs, Message *out) const;
+  double updateFactor(size_t f, const Message *rv_msgs, const Message *prev, Message *next) const;
+  double updateRandomVariable(size_t v, const Message *factor_msgs, const Message *prev,
+                              Message *next) const;
+  double updateFactorMessages(bool forward);
+  double updateRandomVariableMessages(bool forward);
+  void trackDelta(double delta);
+  double floodingIteration();
+  void floodingRange(size_t begin, size_t end);
+  double wavefrontIteration();
+  void wavefrontLevel(size_t level);
+  void residualSchedule();
+  bool updateResiduals(size_t f);
+
+  //! Graph which LBP runs on, either the full graph or the unknown core of
+  //  the current sample when `lbp_compaction` is enabled
+  std::shared_ptr<const Topology> core_;
+
+  //! Observation state of each RV of `core_`, indexed by its dense RV ID
+  std::vector<Observation> core_obs_;
+
+  //! Whether each factor of the full graph is part of `core_`
+  std::vector<uint8_t> core_factors_;
+
+  //! Factor -> RV messages, indexed by edge ID
+  std::vector<Message> factor_msgs_;
+
+  //! RV -> factor messages, indexed by edge ID
+  std::vector<Message> rv_msgs_;
+
+  //! Messages of the next iteration in the flooding schedule
+  std::vector<Message> next_factor_msgs_, next_rv_msgs_;
+
+  //! Pending factor -> RV messages of the residual schedule, indexed by edge ID
+  std::vector<Message> candidate_msgs_;
+
+  //! Difference between each pending and current factor -> RV message
+  std::vector<double> residuals_;
+
+  //! Edge IDs whose residual is at least the convergence tolerance, by residual
+  utils::IndexedHeap residual_queue_;
+
+  //! Largest change of P(RV = 1) of any factor -> RV message in this iteration
+  std::atomic<double> max_delta_;
+
+  //! The first sweep overwrites the initial messages instead of damping them
+  bool first_sweep_;
+
+  //! Workers of the flooding and wavefront schedules
+  std::unique_ptr<utils::ThreadPool> pool_;
+
+  //! Whether the flooding speedup over a serial sweep has been measured yet
+  bool measured_speedup_;
+
+  size_t iterations_;
 };
 
 }  // end namespace hash_reversal
\ No newline at end of file
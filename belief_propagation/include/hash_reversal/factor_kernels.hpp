@@ -0,0 +1,71 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <array>
+
+namespace hash_reversal {
+namespace kernels {
+
+/*
+ * Closed-form factor -> RV messages of each factor type, shared by
+ * `Probability::factorMessages()` and the batched kernels of `BatchFactorGraph`.
+ * `T` is either a double or a vector of lanes which supports + and *, and
+ * both evaluate the same expressions in the same order, so every lane gets
+ * exactly the result of the serial kernel.
+ *
+ * `t` is a probOne() table indexed [out * 4 + in1 * 2 + in2]. `in` and `out`
+ * are indexed by the factor's edges, with the output RV first.
+ */
+
+template <typename T>
+using Pair = std::array<T, 2>;
+
+template <typename T>
+inline void priorMessages(const T *t, Pair<T> *out) {
+  // Table entries for (out, 0, 0)
+  out[0] = {t[0], t[4]};
+}
+
+template <typename T>
+inline void unaryMessages(const T *t, const Pair<T> *in, Pair<T> *out) {
+  // Table entries for (out, in1, 0)
+  const T &t00 = t[0], &t01 = t[2], &t10 = t[4], &t11 = t[6];
+  const Pair<T> &o = in[0], &a = in[1];
+  out[0] = {t00 * a[0] + t01 * a[1], t10 * a[0] + t11 * a[1]};
+  out[1] = {t00 * o[0] + t10 * o[1], t01 * o[0] + t11 * o[1]};
+}
+
+template <typename T>
+inline void andMessages(const T *t, const Pair<T> *in, Pair<T> *out) {
+  const Pair<T> &o = in[0], &a = in[1], &b = in[2];
+
+  // Marginalize the table over one of its three variables at a time
+  const T a0b0 = a[0] * b[0], a0b1 = a[0] * b[1];
+  const T a1b0 = a[1] * b[0], a1b1 = a[1] * b[1];
+  out[0] = {t[0] * a0b0 + t[1] * a0b1 + t[2] * a1b0 + t[3] * a1b1,
+            t[4] * a0b0 + t[5] * a0b1 + t[6] * a1b0 + t[7] * a1b1};
+
+  const T o0b0 = o[0] * b[0], o0b1 = o[0] * b[1];
+  const T o1b0 = o[1] * b[0], o1b1 = o[1] * b[1];
+  out[1] = {t[0] * o0b0 + t[1] * o0b1 + t[4] * o1b0 + t[5] * o1b1,
+            t[2] * o0b0 + t[3] * o0b1 + t[6] * o1b0 + t[7] * o1b1};
+
+  const T o0a0 = o[0] * a[0], o0a1 = o[0] * a[1];
+  const T o1a0 = o[1] * a[0], o1a1 = o[1] * a[1];
+  out[2] = {t[0] * o0a0 + t[2] * o0a1 + t[4] * o1a0 + t[6] * o1a1,
+            t[1] * o0a0 + t[3] * o0a1 + t[5] * o1a0 + t[7] * o1a1};
+}
+
+}  // end namespace kernels
+}  // end namespace hash_reversal
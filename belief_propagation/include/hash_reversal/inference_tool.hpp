@@ -12,12 +12,15 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "hash_reversal/dataset.hpp"
 #include "hash_reversal/factor.hpp"
 #include "hash_reversal/probability.hpp"
+#include "hash_reversal/topology.hpp"
 #include "hash_reversal/variable_assignments.hpp"
 #include "utils/config.hpp"
 #include "utils/convenience.hpp"
@@ -33,11 +36,23 @@ class InferenceTool {
   };
 
   InferenceTool(std::shared_ptr<Probability> prob, std::shared_ptr<Dataset> dataset,
-                std::shared_ptr<utils::Config> config);
+                std::shared_ptr<utils::Config> config, std::shared_ptr<const Topology> graph);
+
+  //! Loads the factor graph once, so that every tool solving it can share it
+  static std::shared_ptr<const Topology> loadGraph(const Dataset &dataset,
+                                                   const utils::Config &config);
 
   virtual ~InferenceTool();
 
-  VariableAssignments propagateObserved(const VariableAssignments &observed) const;
+  /*
+   * Observed values plus every value they imply through the circuit, found
+   * by unit propagation to a fixpoint. An implied value which contradicts a
+   * value known before is a conflict: the earlier value is kept, so observed
+   * values are never overwritten, and the conflict is counted in
+   * `num_conflicts` if it is given.
+   */
+  VariableAssignments propagateObserved(const VariableAssignments &observed,
+                                        size_t *num_conflicts = nullptr) const;
 
   virtual void reconfigure(const VariableAssignments &observed);
 
@@ -47,16 +62,34 @@ class InferenceTool {
 
   std::map<size_t, std::string> factorTypes() const;
 
+  /*
+   * Bytes of the per-sample state of this tool, i.e. its messages and
+   * observations. The shared graph is not included.
+   */
+  virtual size_t memoryBytes() const;
+
  protected:
+  void setObserved(const VariableAssignments &observed);
+
+  //! Largest change of a marginal (or message) which still counts as converged
+  static constexpr double convergence_tol = 1e-4;
+
+  //! Warm-started messages keep P(RV = 1) this far from 0 and 1, so that
+  //  evidence which contradicts an earlier sample can still override them
+  static constexpr double warm_start_floor = 1e-3;
+
   std::shared_ptr<Probability> prob_;
   std::shared_ptr<Dataset> dataset_;
   std::shared_ptr<utils::Config> config_;
-  std::map<size_t, RandomVariable> rvs_;
-  std::map<size_t, Factor> factors_;
+  //! Read-only graph, shared between tools which solve samples in parallel
+  std::shared_ptr<const Topology> graph_;
   VariableAssignments observed_;
 
+  //! Observation state of each RV, indexed by dense RV ID
+  std::vector<Observation> rv_obs_;
+
  private:
-  void printConnections() const;
+  static void printConnections(const Topology &graph);
 };
 
 }  // end namespace hash_reversal
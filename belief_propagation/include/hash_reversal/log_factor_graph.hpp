@@ -0,0 +1,83 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "hash_reversal/inference_tool.hpp"
+
+namespace hash_reversal {
+
+/*
+ * Loopy BP in the log domain. Each edge carries a single log-likelihood ratio
+ * log(m(1) / m(0)) per direction, so RV messages are sums instead of products
+ * and cannot overflow or underflow like the raw messages of `FactorGraph`.
+ *
+ * `T` is the type the messages are stored as. With `double` they are kept
+ * exactly, with `int16_t` or `int8_t` they are saturating fixed-point numbers
+ * like in LDPC decoders, which shrinks the message buffers 4x or 8x. All
+ * arithmetic is still done in double precision.
+ */
+template <typename T>
+class LogFactorGraph : public InferenceTool {
+ public:
+  LogFactorGraph(std::shared_ptr<Probability> prob, std::shared_ptr<Dataset> dataset,
+                 std::shared_ptr<utils::Config> config,
+                 std::shared_ptr<const Topology> graph);
+
+  void solve() override;
+
+  std::vector<InferenceTool::Prediction> marginals() const override;
+
+  size_t memoryBytes() const override;
+
+ protected:
+  void reconfigure(const VariableAssignments &observed) override;
+
+ private:
+  double toLLR(T msg) const;
+  T fromLLR(double llr) const;
+
+  Prediction predict(size_t v) const;
+  double warmStartLLR(double llr) const;
+  bool startMessages();
+  void accumulateMeans();
+  double updateMessage(T &msg, double new_msg) const;
+  double updateFactorMessages(bool forward);
+  void updateRandomVariableMessages(bool forward);
+
+  //! LLR of one step of a quantized message
+  double step_;
+
+  //! Largest change of P(RV = 1) in an iteration which counts as converged
+  double tolerance_;
+
+  //! Factor -> RV log-likelihood ratios, indexed by edge ID
+  std::vector<T> factor_llrs_;
+
+  //! RV -> factor log-likelihood ratios, indexed by edge ID
+  std::vector<T> rv_llrs_;
+
+  //! Running means of the LLRs of every solve so far, which the "average"
+  //  warm start begins from
+  std::vector<double> mean_factor_llrs_, mean_rv_llrs_;
+
+  //! Number of solves in the running means
+  size_t num_means_;
+
+  //! The first sweep overwrites the initial messages instead of damping them
+  bool first_sweep_;
+};
+
+}  // end namespace hash_reversal
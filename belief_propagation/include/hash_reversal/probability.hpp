@@ -14,25 +14,61 @@
 
 #include <spdlog/spdlog.h>
 
-#include <boost/dynamic_bitset.hpp>
+#include <array>
+#include <cstdint>
 #include <memory>
-#include <vector>
 
 #include "hash_reversal/factor.hpp"
-#include "hash_reversal/variable_assignments.hpp"
 #include "utils/config.hpp"
 
 namespace hash_reversal {
 
+//! Unnormalized message for RV value 0 (index 0) and RV value 1 (index 1)
+typedef std::array<double, 2> Message;
+
+//! Observation state of an RV, either a known bit value or `UNOBSERVED`
+enum Observation : uint8_t { OBSERVED_ZERO = 0, OBSERVED_ONE = 1, UNOBSERVED = 2 };
+
 class Probability {
  public:
   explicit Probability(std::shared_ptr<utils::Config> config);
 
-  double probOne(const Factor &factor, const VariableAssignments &assignments,
-                 const VariableAssignments &observed) const;
+  double probOne(FactorType type, Observation out_obs, bool out, bool in1 = false,
+                 bool in2 = false) const;
+
+  /*
+   * Computes the outgoing factor -> RV messages on every edge of a factor.
+   *
+   * `in` and `out` are indexed by the factor's edges, with the output RV first
+   * (see `Topology`). `in` holds the incoming RV -> factor messages, where
+   * messages from observed RVs must already be masked to their observed value.
+   * `out_obs` is the observation state of the factor's output RV.
+   */
+  void factorMessages(FactorType type, Observation out_obs, const Message *in,
+                      Message *out) const;
+
+  /*
+   * Log-domain counterpart of factorMessages(). Messages are log-likelihood
+   * ratios log(m(1) / m(0)) and observed RVs are given by `obs` rather than
+   * by masking, because an observation would be an infinite LLR.
+   *
+   * The incoming LLRs are turned into normalized probabilities, so both sums
+   * of the kernel are at least `epsilon` and the outgoing LLRs are bounded by
+   * log(1 / epsilon) no matter how large the incoming ones are.
+   */
+  void factorLLRs(FactorType type, Observation out_obs, const Observation *obs,
+                  const double *in, double *out, size_t n) const;
+
+  //! Pre-computed probOne() table, indexed [out * 4 + in1 * 2 + in2]
+  const double *table(FactorType type, Observation out_obs) const {
+    return tables_[size_t(type)][out_obs].data();
+  }
 
  private:
   std::shared_ptr<utils::Config> config_;
+
+  //! Pre-computed probOne() tables, indexed [type][out_obs][out * 4 + in1 * 2 + in2]
+  std::array<std::array<std::array<double, 8>, 3>, 5> tables_;
 };
 
-}  // end namespace hash_reversal
\ No newline at end of file
+}  // end namespace hash_reversal
@@ -0,0 +1,86 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <boost/dynamic_bitset.hpp>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+namespace hash_reversal {
+
+/*
+ * Read-only view of one sample in the `data.bits` layout: the bits of the
+ * sample are stored most significant bit first in consecutive bytes, starting
+ * at a word boundary. The memory is either the memory-mapped data file itself
+ * or a buffer of the `Dataset`, and the view only shares ownership of it in
+ * streaming mode.
+ */
+class SampleView {
+ public:
+  static constexpr size_t kWordBits = 64;
+
+  SampleView() : bytes_(nullptr), size_(0) {}
+
+  SampleView(const unsigned char *bytes, size_t size, std::shared_ptr<const void> owner = nullptr)
+      : bytes_(bytes), size_(size), owner_(std::move(owner)) {}
+
+  //! Number of bits in the sample
+  size_t size() const { return size_; }
+
+  //! Number of 64-bit words the sample occupies
+  size_t numWords() const { return (size_ + kWordBits - 1) / kWordBits; }
+
+  bool operator[](size_t bit) const { return (bytes_[bit / 8] >> (7 - bit % 8)) & 1; }
+
+  /*
+   * Bits [64 * w, 64 * w + 64) of the sample, with the first one as the most
+   * significant bit. Bits past the end of the sample are 0.
+   */
+  uint64_t word(size_t w) const { return loadWord(bytes_ + w * sizeof(uint64_t)); }
+
+  //! Loads 8 bytes as a big-endian word, i.e. in the bit order of `data.bits`
+  static uint64_t loadWord(const unsigned char *bytes) {
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+  }
+
+  //! Stores a word so that `loadWord` reads it back
+  static void storeWord(uint64_t word, unsigned char *bytes) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    std::memcpy(bytes, &word, sizeof(word));
+  }
+
+  //! Copies the bits [0, num_bits) into a bitset
+  boost::dynamic_bitset<> toBitset(size_t num_bits) const {
+    boost::dynamic_bitset<> bits(num_bits);
+    for (size_t i = 0; i < num_bits; ++i) bits[i] = (*this)[i];
+    return bits;
+  }
+
+  boost::dynamic_bitset<> toBitset() const { return toBitset(size_); }
+
+ private:
+  const unsigned char *bytes_;
+  size_t size_;
+  std::shared_ptr<const void> owner_;
+};
+
+}  // end namespace hash_reversal
@@ -0,0 +1,151 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "hash_reversal/factor.hpp"
+
+namespace hash_reversal {
+
+/*
+ * Compressed-sparse-row (CSR) view of the factor graph.
+ *
+ * Random variables and factors are renumbered with dense IDs. RVs keep the
+ * order of their original index and factors keep the order of their output
+ * RV, so sweeping the dense IDs visits nodes in the same order as iterating
+ * the `std::map` they were loaded from.
+ *
+ * Every (factor, RV) connection is an "edge". The edges of factor `f` are the
+ * contiguous range [factorBegin(f), factorEnd(f)), so edge IDs can be used
+ * directly as indices into flat per-edge message buffers. The first edge of a
+ * factor always connects to its output RV, followed by the inputs in order of
+ * their original index. The edges of RV `v` are listed in rvEdges() between
+ * rvBegin(v) and rvEnd(v).
+ *
+ * The hash circuit is a DAG, so factors are also grouped by topological level:
+ * a factor's level is one more than the highest level of the factors that
+ * compute its inputs, and PRIOR factors are on level 0.
+ *
+ * All of this can be saved to a binary file and loaded back without parsing,
+ * which is used to cache the graph next to `factors.txt`.
+ */
+class Topology {
+ public:
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+  Topology();
+
+  explicit Topology(const std::map<size_t, Factor> &factors);
+
+  /*
+   * Subgraph of `graph` with the factors for which `keep_factor` is nonzero
+   * and the RVs they reference. Nodes and edges keep their relative order, so
+   * this is the same graph as building one from those factors' `std::map`.
+   */
+  Topology(const Topology &graph, const std::vector<uint8_t> &keep_factor);
+
+  size_t numRVs() const { return rv_indices_.size(); }
+  size_t numFactors() const { return factor_types_.size(); }
+  size_t numEdges() const { return edge_rv_.size(); }
+
+  //! Original RV index (bit index in a sample) of the dense RV `v`
+  size_t rvIndex(size_t v) const { return rv_indices_[v]; }
+
+  //! Dense ID of the RV with original index `rv_index`, or `npos`
+  size_t denseRV(size_t rv_index) const {
+    return rv_index < dense_rvs_.size() ? dense_rvs_[rv_index] : npos;
+  }
+
+  //! Factor `f` in terms of original RV indices, built on demand
+  Factor factor(size_t f) const;
+
+  //! Name of the factor type in `factors.txt`, e.g. "AND"
+  const std::string &factorName(size_t f) const { return type_names_[factor_names_[f]]; }
+
+  FactorType factorType(size_t f) const { return factor_types_[f]; }
+
+  //! Dense ID of the RV which is the output of factor `f`
+  size_t factorOutput(size_t f) const { return factor_outputs_[f]; }
+
+  //! Dense ID of the factor whose output is RV `v`, or `npos`
+  size_t rvFactor(size_t v) const { return rv_factors_[v]; }
+
+  size_t factorBegin(size_t f) const { return factor_offsets_[f]; }
+  size_t factorEnd(size_t f) const { return factor_offsets_[f + 1]; }
+
+  size_t rvBegin(size_t v) const { return rv_offsets_[v]; }
+  size_t rvEnd(size_t v) const { return rv_offsets_[v + 1]; }
+
+  //! Edge IDs adjacent to RVs, indexed through rvBegin() / rvEnd()
+  const std::vector<size_t> &rvEdges() const { return rv_edges_; }
+
+  size_t edgeRV(size_t e) const { return edge_rv_[e]; }
+  size_t edgeFactor(size_t e) const { return edge_factor_[e]; }
+
+  size_t numLevels() const { return level_offsets_.size() - 1; }
+  size_t factorLevel(size_t f) const { return factor_levels_[f]; }
+
+  size_t levelBegin(size_t l) const { return level_offsets_[l]; }
+  size_t levelEnd(size_t l) const { return level_offsets_[l + 1]; }
+
+  //! Factor IDs sorted by level, indexed through levelBegin() / levelEnd()
+  const std::vector<size_t> &levelFactors() const { return level_factors_; }
+
+  //! Bytes held by the arrays of the graph
+  size_t memoryBytes() const;
+
+  /*
+   * Writes the graph to a binary file, tagged with the checksum of the text
+   * it was parsed from and a checksum of the arrays themselves. Returns false
+   * if the file could not be written.
+   */
+  bool save(const std::string &file, uint64_t checksum) const;
+
+  /*
+   * Replaces this graph with the one in a binary file written by save().
+   * The file is only mapped while its arrays are copied into this graph, so
+   * loading saves the parsing but not the memory. Returns false, and leaves
+   * the graph as it was, if the file is missing, fails its checksum or the
+   * consistency checks of the arrays, or was made from text with a different
+   * checksum.
+   */
+  bool load(const std::string &file, uint64_t checksum);
+
+ private:
+  void computeLevels();
+
+  std::vector<std::string> type_names_;
+  std::vector<uint8_t> factor_names_;
+  std::vector<FactorType> factor_types_;
+  std::vector<size_t> factor_outputs_;
+  std::vector<size_t> factor_offsets_;
+  std::vector<size_t> edge_rv_;
+  std::vector<size_t> edge_factor_;
+
+  std::vector<size_t> rv_indices_;
+  std::vector<size_t> dense_rvs_;
+  std::vector<size_t> rv_factors_;
+  std::vector<size_t> rv_offsets_;
+  std::vector<size_t> rv_edges_;
+
+  std::vector<size_t> factor_levels_;
+  std::vector<size_t> level_offsets_;
+  std::vector<size_t> level_factors_;
+};
+
+}  // end namespace hash_reversal
@@ -36,6 +36,16 @@ class Config {
 
   size_t lbp_max_iter;
   double lbp_damping;
+  std::string lbp_schedule;
+  std::string lbp_quantization;
+  bool lbp_compaction;
+  std::string lbp_warm_start;
+  size_t num_threads;
+  size_t batch_size;
+  size_t num_workers;
+  bool dataset_streaming;
+  size_t sample_offset;
+  size_t sample_stride;
   double epsilon;
   std::string hash_algo;
   std::string dataset_dir;
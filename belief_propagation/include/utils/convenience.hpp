@@ -16,6 +16,7 @@
 #include <array>
 #include <boost/dynamic_bitset.hpp>
 #include <chrono>
+#include <cstdint>
 #include <cstdio>
 #include <iostream>
 #include <memory>
@@ -36,6 +37,11 @@ class Convenience {
     return std::chrono::duration_cast<std::chrono::seconds>(now).count();
   }
 
+  //! Seconds elapsed since `start` on a monotonic clock, for log messages
+  static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
   template <typename T>
   static std::string vec2str(const std::vector<T> &v, bool brackets = true) {
     auto begin = v.begin();
@@ -89,6 +95,18 @@ class Convenience {
     return out;
   }
 
+  //! 64-bit FNV-1a hash, used to tell whether a cached file is still current
+  static uint64_t checksum(const char *data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i) {
+      hash ^= static_cast<unsigned char>(data[i]);
+      hash *= 0x100000001b3ull;
+    }
+    return hash;
+  }
+
+  static uint64_t checksum(const std::string &data) { return checksum(data.data(), data.size()); }
+
   static std::string exec(const std::string &cmd) {
     std::array<char, 128> buffer;
     std::string result;
@@ -0,0 +1,120 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "utils/memory.hpp"
+
+namespace utils {
+
+/*
+ * Binary max-heap over the IDs [0, n), each with a priority. Every ID is in
+ * the heap at most once and its priority can be changed in place, so the heap
+ * never holds more than n entries and popping never returns a stale one.
+ */
+class IndexedHeap {
+ public:
+  //! Empties the heap and makes room for the IDs [0, n)
+  void reset(size_t n) {
+    heap_.clear();
+    priorities_.assign(n, 0.0);
+    positions_.assign(n, npos);
+  }
+
+  bool empty() const { return heap_.empty(); }
+  size_t size() const { return heap_.size(); }
+
+  //! ID with the highest priority, the heap must not be empty
+  size_t top() const { return heap_.front(); }
+
+  //! Inserts `id`, or moves it if it is already in the heap
+  void set(size_t id, double priority) {
+    priorities_[id] = priority;
+    if (positions_[id] == npos) {
+      positions_[id] = heap_.size();
+      heap_.push_back(id);
+      siftUp(heap_.size() - 1);
+    } else {
+      siftDown(siftUp(positions_[id]));
+    }
+  }
+
+  //! Removes `id` if it is in the heap
+  void erase(size_t id) {
+    const size_t pos = positions_[id];
+    if (pos == npos) return;
+    positions_[id] = npos;
+    const size_t last = heap_.back();
+    heap_.pop_back();
+    if (pos == heap_.size()) return;
+    heap_[pos] = last;
+    positions_[last] = pos;
+    siftDown(siftUp(pos));
+  }
+
+  void pop() { erase(top()); }
+
+  //! Bytes held by the heap and its per-ID arrays
+  size_t memoryBytes() const {
+    return Memory::bytes(heap_) + Memory::bytes(priorities_) + Memory::bytes(positions_);
+  }
+
+ private:
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+  //! Moves the entry at `pos` up while its parent has a lower priority
+  size_t siftUp(size_t pos) {
+    const size_t id = heap_[pos];
+    while (pos > 0) {
+      const size_t parent = (pos - 1) / 2;
+      if (priorities_[heap_[parent]] >= priorities_[id]) break;
+      heap_[pos] = heap_[parent];
+      positions_[heap_[pos]] = pos;
+      pos = parent;
+    }
+    heap_[pos] = id;
+    positions_[id] = pos;
+    return pos;
+  }
+
+  //! Moves the entry at `pos` down while a child has a higher priority
+  void siftDown(size_t pos) {
+    const size_t id = heap_[pos];
+    const size_t n = heap_.size();
+    while (true) {
+      size_t child = 2 * pos + 1;
+      if (child >= n) break;
+      if (child + 1 < n && priorities_[heap_[child + 1]] > priorities_[heap_[child]]) ++child;
+      if (priorities_[heap_[child]] <= priorities_[id]) break;
+      heap_[pos] = heap_[child];
+      positions_[heap_[pos]] = pos;
+      pos = child;
+    }
+    heap_[pos] = id;
+    positions_[id] = pos;
+  }
+
+  //! IDs in heap order
+  std::vector<size_t> heap_;
+
+  //! Priority of each ID, indexed by ID
+  std::vector<double> priorities_;
+
+  //! Position of each ID in `heap_`, or npos if it is not in the heap
+  std::vector<size_t> positions_;
+};
+
+}  // end namespace utils
@@ -0,0 +1,69 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace utils {
+
+/*
+ * Accounting of the bytes held by the major data structures (samples,
+ * topology, messages, marginals, statistics), so that it is clear which of
+ * them grows when a large graph runs out of memory. Containers count their
+ * allocated capacity, not only the elements in use.
+ */
+class Memory {
+ public:
+  //! Bytes held by each subsystem, by name
+  typedef std::vector<std::pair<std::string, size_t>> Usage;
+
+  template <typename T>
+  static size_t bytes(const std::vector<T> &v) {
+    return v.capacity() * sizeof(T);
+  }
+
+  //! Estimate for `std::map`, whose nodes hold 3 pointers and a color besides the value
+  template <typename K, typename V>
+  static size_t bytes(const std::map<K, V> &m) {
+    return m.size() * (sizeof(typename std::map<K, V>::value_type) + 4 * sizeof(void *));
+  }
+
+  //! Peak resident set size of the process in bytes
+  static size_t peakRSS();
+
+  //! Current resident set size of the process in bytes, or 0 if unknown
+  static size_t currentRSS();
+
+  //! Resident bytes backed by files (mapped data, code), or 0 if unknown
+  static size_t fileRSS();
+
+  /*
+   * Logs the bytes of each subsystem at the end of `phase`, the bytes of
+   * files mapped in place, and the RSS.
+   */
+  static void log(const std::string &phase, const Usage &usage, size_t mapped);
+
+  /*
+   * Logs one line per subsystem with its share of the current RSS, and how
+   * much of the RSS is not accounted for (allocator overhead, stacks, ...).
+   * Files mapped in place are listed apart with their resident file-backed
+   * pages, since the kernel can drop those pages under memory pressure.
+   */
+  static void logSummary(const Usage &usage, size_t mapped);
+};
+
+}  // end namespace utils
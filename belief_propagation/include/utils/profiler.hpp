@@ -0,0 +1,129 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Instrumentation macros. They compile to nothing unless the build defines
+ * HASH_REVERSAL_PROFILE (`cmake -DHASH_REVERSAL_PROFILE=ON`).
+ *
+ *   PROFILE_SCOPE("name")     times the enclosing scope as phase "name"
+ *   PROFILE_COUNT("name", n)  adds n to counter "name"
+ *   PROFILE_VALUE("name", x)  adds x to the distribution "name", or counts
+ *                             it apart if it is infinite or NaN
+ *   PROFILE_SAVE(json, trace) writes the summary and the trace events
+ *
+ * Names must be string literals.
+ */
+#ifdef HASH_REVERSAL_PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) \
+  const utils::Profiler::Scope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_COUNT(name, n) utils::Profiler::instance().count(name, n)
+#define PROFILE_VALUE(name, x) utils::Profiler::instance().value(name, x)
+#define PROFILE_SAVE(json, trace) utils::Profiler::instance().save(json, trace)
+#else
+#define PROFILE_SCOPE(name) (void)0
+#define PROFILE_COUNT(name, n) (void)0
+#define PROFILE_VALUE(name, x) (void)0
+#define PROFILE_SAVE(json, trace) (void)0
+#endif
+
+namespace utils {
+
+/*
+ * Collects phase timings from a monotonic clock, counters and value
+ * distributions. Every thread records into its own buffers, so recording
+ * takes no locks, and the buffers are merged by name when saving.
+ */
+class Profiler {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  //! Times its own lifetime as one occurrence of a phase
+  class Scope {
+   public:
+    explicit Scope(const char *name)
+        : name_(name), profiler_(Profiler::instance()), start_(Clock::now()) {}
+    ~Scope() { profiler_.record(name_, start_, Clock::now()); }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+   private:
+    const char *name_;
+    Profiler &profiler_;
+    Clock::time_point start_;
+  };
+
+  static Profiler &instance();
+
+  void record(const char *phase, Clock::time_point start, Clock::time_point end);
+
+  void count(const char *counter, uint64_t n);
+
+  void value(const char *name, double x);
+
+  /*
+   * Writes per-phase totals, counters and distributions as JSON to
+   * `summary_file`, and every timed phase as a Chrome trace event
+   * (chrome://tracing, Perfetto) to `trace_file`. Call it when no other thread
+   * is recording.
+   */
+  void save(const std::string &summary_file, const std::string &trace_file) const;
+
+ private:
+  //! Trace events kept per thread, later phases are only summarized
+  static constexpr size_t kMaxEvents = size_t(1) << 20;
+
+  struct Event {
+    const char *name;
+    int64_t start_ns, duration_ns;
+  };
+
+  //! Non-finite values, e.g. the infinite residual of a first iteration, are only counted
+  struct Distribution {
+    uint64_t count = 0, non_finite = 0;
+    double sum = 0.0, min = 0.0, max = 0.0;
+    void add(double x);
+    void merge(const Distribution &other);
+  };
+
+  struct ThreadData {
+    size_t tid;
+    std::vector<Event> events;
+    std::unordered_map<const char *, Distribution> phases;
+    std::unordered_map<const char *, uint64_t> counters;
+    std::unordered_map<const char *, Distribution> values;
+  };
+
+  Profiler();
+
+  ThreadData &local();
+
+  //! Time which the trace timestamps are relative to
+  const Clock::time_point origin_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<ThreadData>> threads_;
+};
+
+}  // end namespace utils
@@ -14,98 +14,182 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 #include "utils/config.hpp"
 #include "utils/convenience.hpp"
+#include "utils/memory.hpp"
 
 namespace utils {
 
+/*
+ * Prediction statistics over all test samples. Counters are dense arrays
+ * indexed by RV or factor type, and the predicted probabilities go into
+ * fixed-size histograms, so updates do not allocate and memory does not grow
+ * with the number of samples. `save()` writes them in binary form, which
+ * `process_stats.py` reads.
+ */
 class Stats {
  public:
+  //! Number of histogram bins over [0, 1] of the probability a bit is one
+  static constexpr size_t kNumBins = 100;
+
   Stats(std::shared_ptr<Config> config, const std::map<size_t, std::string> &f_types)
-      : config_(config), factor_types_(f_types) {
+      : config_(config),
+        rv_types_(config->num_bits_per_sample, kNoType),
+        correct_hist_(kNumBins, 0),
+        incorrect_hist_(kNumBins, 0),
+        num_correct_per_rv_(config->num_bits_per_sample, 0),
+        count_per_rv_(config->num_bits_per_sample, 0),
+        num_ones_per_rv_(config->num_bits_per_sample, 0) {
+    for (auto &itr : f_types) {
+      if (std::find(type_names_.begin(), type_names_.end(), itr.second) == type_names_.end()) {
+        type_names_.push_back(itr.second);
+      }
+    }
+    std::sort(type_names_.begin(), type_names_.end());
+    for (auto &itr : f_types) {
+      const auto type = std::find(type_names_.begin(), type_names_.end(), itr.second);
+      rv_types_.at(itr.first) = static_cast<uint8_t>(type - type_names_.begin());
+    }
+    num_correct_per_factor_.assign(type_names_.size(), 0);
+    count_per_factor_.assign(type_names_.size(), 0);
   }
 
   void update(size_t rv_index, bool predicted_val, bool true_val, double prob_one,
               bool is_observed) {
     const bool is_correct = (predicted_val == true_val);
 
-    if (!is_observed) {
-      (is_correct ? correct_pred_ : incorrect_pred_).push_back(prob_one);
+    // NaN predictions count towards the accuracies but not the histograms
+    if (!is_observed && !std::isnan(prob_one)) {
+      const size_t bin = std::min(kNumBins - 1, static_cast<size_t>(
+                                                    std::max(0.0, prob_one) * kNumBins));
+      (is_correct ? correct_hist_ : incorrect_hist_)[bin] += 1;
     }
 
+    const uint8_t f_type = rv_types_.at(rv_index);
+    if (f_type == kNoType) {
+      throw std::out_of_range("RV " + std::to_string(rv_index) + " has no factor type");
+    }
     num_correct_per_rv_[rv_index] += is_correct;
-    const std::string &f_type = factor_types_.at(rv_index);
     num_correct_per_factor_[f_type] += is_correct;
-    rv_cumulative_val_[rv_index] += true_val;
     count_per_rv_[rv_index] += 1;
     count_per_factor_[f_type] += 1;
   }
 
-  void save() const {
-    const std::string filename = "statistics.txt";
-    std::ofstream data(filename);
-
-    data << "probability bit is one for correct predictions" << std::endl;
-    data << Convenience::vec2str<double>(correct_pred_, false) << std::endl;
-
-    data << "probability bit is one for incorrect predictions" << std::endl;
-    data << Convenience::vec2str<double>(incorrect_pred_, false) << std::endl;
+  //! Adds the statistics collected by `other`, e.g. by another worker thread
+  void merge(const Stats &other) {
+    const auto add = [](std::vector<uint64_t> &a, const std::vector<uint64_t> &b) {
+      for (size_t i = 0; i < a.size(); ++i) a[i] += b[i];
+    };
+    add(correct_hist_, other.correct_hist_);
+    add(incorrect_hist_, other.incorrect_hist_);
+    add(num_correct_per_rv_, other.num_correct_per_rv_);
+    add(num_correct_per_factor_, other.num_correct_per_factor_);
+    add(count_per_rv_, other.count_per_rv_);
+    add(count_per_factor_, other.count_per_factor_);
+    add(num_ones_per_rv_, other.num_ones_per_rv_);
+  }
 
-    data << "bit accuracies" << std::endl;
-    for (auto &itr : num_correct_per_rv_) {
-      const size_t rv = itr.first;
-      data << rv << "," << itr.second / count_per_rv_.at(rv);
-      data << std::endl;
+  //! RVs that were seen so far, in ascending order
+  std::vector<size_t> rvIndices() const {
+    std::vector<size_t> rv_indices;
+    for (size_t rv = 0; rv < count_per_rv_.size(); ++rv) {
+      if (count_per_rv_[rv] > 0) rv_indices.push_back(rv);
     }
+    return rv_indices;
+  }
 
-    data << "factor accuracies" << std::endl;
-    for (auto &itr : num_correct_per_factor_) {
-      data << itr.first << "," << itr.second / count_per_factor_.at(itr.first);
-      data << std::endl;
-    }
+  //! Bytes held by the counters and histograms
+  size_t memoryBytes() const {
+    return Memory::bytes(type_names_) + Memory::bytes(rv_types_) + Memory::bytes(correct_hist_) +
+           Memory::bytes(incorrect_hist_) + Memory::bytes(num_correct_per_rv_) +
+           Memory::bytes(num_correct_per_factor_) + Memory::bytes(count_per_rv_) +
+           Memory::bytes(count_per_factor_) + Memory::bytes(num_ones_per_rv_);
+  }
+
+  //! Adds the number of samples of a block in which an RV is 1
+  void addNumOnes(size_t rv_index, uint64_t num_ones) {
+    num_ones_per_rv_.at(rv_index) += num_ones;
+  }
 
-    data << "bit mean values" << std::endl;
-    for (auto &itr : rv_cumulative_val_) {
-      const size_t rv = itr.first;
-      data << rv << "," << itr.second / count_per_rv_.at(rv);
-      data << std::endl;
+  /*
+   * Writes the statistics to `statistics.bin` as native-endian 64-bit
+   * integers: the magic "HRSTATS1", the number of bins, RVs and factor types,
+   * the correct and incorrect histograms, the per-RV counts, correct counts and
+   * numbers of ones, the factor type names as (length, characters), and the
+   * per-type counts and correct counts.
+   */
+  void save() const {
+    const std::string filename = "statistics.bin";
+    std::ofstream data(filename, std::ios::out | std::ios::binary);
+
+    const auto write = [&](uint64_t value) {
+      data.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    };
+    const auto write_array = [&](const std::vector<uint64_t> &values) {
+      data.write(reinterpret_cast<const char *>(values.data()),
+                 values.size() * sizeof(uint64_t));
+    };
+
+    data.write("HRSTATS1", 8);
+    write(kNumBins);
+    write(count_per_rv_.size());
+    write(type_names_.size());
+    write_array(correct_hist_);
+    write_array(incorrect_hist_);
+    write_array(count_per_rv_);
+    write_array(num_correct_per_rv_);
+    write_array(num_ones_per_rv_);
+    for (const auto &name : type_names_) {
+      write(name.size());
+      data.write(name.data(), name.size());
     }
+    write_array(count_per_factor_);
+    write_array(num_correct_per_factor_);
 
     data.close();
     spdlog::info("Statistics were written to '{}'", filename);
   }
 
  private:
+  static constexpr uint8_t kNoType = 0xFF;
+
   std::shared_ptr<Config> config_;
 
-  //! Each RV at index `i` has an associated factor of some type (XOR, AND, ...)
-  std::map<size_t, std::string> factor_types_;
+  //! Names of the factor types (XOR, AND, ...), sorted
+  std::vector<std::string> type_names_;
+
+  //! Each RV at index `i` has an associated factor of some type
+  std::vector<uint8_t> rv_types_;
 
-  //! Tracks "probability the bit is one" for each (in)correct bit prediction.
-  //  Observed bits (hash output bits) are excluded.
-  std::vector<double> correct_pred_, incorrect_pred_;
+  //! Histograms of "probability the bit is one" for (in)correct bit
+  //  predictions. Observed bits (hash output bits) are excluded.
+  std::vector<uint64_t> correct_hist_, incorrect_hist_;
 
   //! Counts the number of correct predictions for each random variable
-  std::map<size_t, double> num_correct_per_rv_;
+  std::vector<uint64_t> num_correct_per_rv_;
 
   //! Counts the number of correct predictions for each factor type
-  std::map<std::string, double> num_correct_per_factor_;
-
-  //! Cumulative sum of the value of each random variable when it is seen
-  std::map<size_t, double> rv_cumulative_val_;
+  std::vector<uint64_t> num_correct_per_factor_;
 
   //! Number of times each random variable is seen
-  std::map<size_t, double> count_per_rv_;
+  std::vector<uint64_t> count_per_rv_;
 
   //! Number of times each factor type is seen
-  std::map<std::string, double> count_per_factor_;
+  std::vector<uint64_t> count_per_factor_;
+
+  //! Number of samples in which each random variable is 1
+  std::vector<uint64_t> num_ones_per_rv_;
 };
 
-}  // end namespace utils
\ No newline at end of file
+}  // end namespace utils
@@ -0,0 +1,116 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+/*
+ * Fixed-size pool of worker threads which runs one data-parallel loop at a
+ * time. The calling thread takes part in every loop as worker 0, so a pool
+ * of size 1 never starts a thread and runs everything inline.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t num_threads) : num_threads_(std::max<size_t>(1, num_threads)) {
+    for (size_t t = 1; t < num_threads_; ++t) {
+      workers_.emplace_back([this, t]() { workerLoop(t); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto &worker : workers_) worker.join();
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  size_t size() const { return num_threads_; }
+
+  /*
+   * Splits [0, n) into one contiguous chunk per thread and calls
+   * `fn(begin, end)` on each chunk. Blocks until every chunk is done.
+   */
+  void parallelFor(size_t n, const std::function<void(size_t, size_t)> &fn) {
+    if (num_threads_ == 1 || n < num_threads_) {
+      fn(0, n);
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_ = &fn;
+      task_size_ = n;
+      pending_ = num_threads_ - 1;
+      ++generation_;
+    }
+    start_cv_.notify_all();
+
+    runChunk(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]() { return pending_ == 0; });
+    task_ = nullptr;
+  }
+
+ private:
+  void runChunk(size_t t) const {
+    const size_t begin = task_size_ * t / num_threads_;
+    const size_t end = task_size_ * (t + 1) / num_threads_;
+    if (begin < end) (*task_)(begin, end);
+  }
+
+  void workerLoop(size_t t) {
+    size_t seen_generation = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_cv_.wait(lock, [&]() { return stop_ || generation_ != seen_generation; });
+        if (stop_) return;
+        seen_generation = generation_;
+      }
+
+      runChunk(t);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --pending_;
+      }
+      done_cv_.notify_one();
+    }
+  }
+
+  const size_t num_threads_;
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable start_cv_, done_cv_;
+  const std::function<void(size_t, size_t)> *task_ = nullptr;
+  size_t task_size_ = 0;
+  size_t pending_ = 0;
+  size_t generation_ = 0;
+  bool stop_ = false;
+};
+
+}  // end namespace utils
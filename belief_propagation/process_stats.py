@@ -1,57 +1,62 @@
 # -*- coding: utf-8 -*-
 #!/usr/bin/python3
 
-from matplotlib import pyplot as plt
-
-SECTIONS = set([
-    'probability bit is one for correct predictions',
-    'probability bit is one for incorrect predictions',
-    'bit accuracies',
-    'factor accuracies',
-    'bit mean values'
-])
-
-
-def line2nums(line):
-    return [float(x) for x in line.split(',') if len(x.strip()) > 0]
-
-
-def process_section(section, lines):
-    if section == 'probability bit is one for correct predictions':
-        return line2nums(lines[0])
-    if section == 'probability bit is one for incorrect predictions':
-        return line2nums(lines[0])
-    if section == 'bit accuracies':
-        return [float(x.split(',')[1]) for x in lines]
-    if section == 'factor accuracies':
-        return {x.split(',')[0]: float(x.split(',')[1]) for x in lines}
-    if section == 'bit mean values':
-        return [float(x.split(',')[1]) for x in lines]
-    raise NotImplementedError('Unknown section: "{}"'.format(section))
+import struct
 
 
 def load_data(filename):
-    data = dict()
-
-    with open(filename, 'r') as f:
-        lines = [line.strip() for line in f if len(line.strip()) > 0]
-
-        for section in SECTIONS:
-            section_idx = lines.index(section)
-            next_section_idx = section_idx + 1
-            while next_section_idx < len(lines):
-                if lines[next_section_idx] in SECTIONS:
-                    break
-                next_section_idx += 1
-            relevant_lines = lines[section_idx + 1:next_section_idx]
-            data[section] = process_section(section, relevant_lines)
-            print('Processed section "{}"'.format(section))
-
-    return data
+    """
+    Reads the `statistics.bin` file written by `utils::Stats::save()`.
+    """
+
+    with open(filename, 'rb') as f:
+        raw = f.read()
+
+    if raw[:8] != b'HRSTATS1':
+        raise ValueError('"{}" is not a statistics file'.format(filename))
+    offset = 8
+
+    def read_array(count):
+        nonlocal offset
+        values = list(struct.unpack_from('={}Q'.format(count), raw, offset))
+        offset += 8 * count
+        return values
+
+    nbins, n_rvs, n_types = read_array(3)
+    correct_hist = read_array(nbins)
+    incorrect_hist = read_array(nbins)
+    count_per_rv = read_array(n_rvs)
+    num_correct_per_rv = read_array(n_rvs)
+    num_ones_per_rv = read_array(n_rvs)
+
+    type_names = []
+    for _ in range(n_types):
+        (length, ) = struct.unpack_from('=Q', raw, offset)
+        type_names.append(raw[offset + 8:offset + 8 + length].decode())
+        offset += 8 + length
+    count_per_factor = read_array(n_types)
+    num_correct_per_factor = read_array(n_types)
+
+    # Only RVs which were predicted have statistics
+    seen = [rv for rv in range(n_rvs) if count_per_rv[rv] > 0]
+
+    return {
+        'probability bit is one for correct predictions': correct_hist,
+        'probability bit is one for incorrect predictions': incorrect_hist,
+        'bit indices': seen,
+        'bit accuracies': [num_correct_per_rv[rv] / count_per_rv[rv] for rv in seen],
+        'factor accuracies': {
+            name: num_correct_per_factor[i] / count_per_factor[i]
+            for i, name in enumerate(type_names) if count_per_factor[i] > 0
+        },
+        'bit mean values': [num_ones_per_rv[rv] / count_per_rv[rv] for rv in seen]
+    }
 
 
 if __name__ == '__main__':
-    data = load_data('statistics.txt')
+    from matplotlib import pyplot as plt
+
+    data = load_data('statistics.bin')
 
     print('WARNING: Remember, input bits can be incorrectly predicted but still result in the correct hash!')
 
@@ -60,18 +65,17 @@ if __name__ == '__main__':
     for f_type in sorted(f_accuracies.keys()):
         print('\t{} --> {}'.format(f_type, f_accuracies[f_type]))
 
-    nbins = 60
+    correct_hist = data['probability bit is one for correct predictions']
+    incorrect_hist = data['probability bit is one for incorrect predictions']
+    nbins = len(correct_hist)
+    centers = [(i + 0.5) / nbins for i in range(nbins)]
     fig, axs = plt.subplots(1, 2, sharey=True, tight_layout=True)
     axs[0].set_title('Correct predictions')
     axs[0].set_xlabel('Prob. hash input bit is 1')
-    axs[0].hist(
-        data['probability bit is one for correct predictions'],
-        bins=nbins)
+    axs[0].bar(centers, correct_hist, width=1.0 / nbins)
     axs[1].set_title('Incorrect predictions')
     axs[1].set_xlabel('Prob. hash input bit is 1')
-    axs[1].hist(
-        data['probability bit is one for incorrect predictions'],
-        bins=nbins)
+    axs[1].bar(centers, incorrect_hist, width=1.0 / nbins)
 
     n = len(data['bit accuracies'])
     m = len(data['bit mean values'])
@@ -81,10 +85,10 @@ if __name__ == '__main__':
     axs[0].set_title('Bit accuracies')
     axs[0].set_xlabel('Bit index')
     axs[0].set_ylabel('Accuracy [0-1]')
-    axs[0].scatter(range(n), data['bit accuracies'], s=0.1)
+    axs[0].scatter(data['bit indices'], data['bit accuracies'], s=0.1)
     axs[1].set_title('Bit mean values')
     axs[1].set_xlabel('Bit index')
     axs[1].set_ylabel('Mean value [0-1]')
-    axs[1].scatter(range(n), data['bit mean values'], s=0.1)
+    axs[1].scatter(data['bit indices'], data['bit mean values'], s=0.1)
 
     plt.show()
@@ -0,0 +1,347 @@
+# -*- coding: utf-8 -*-
+#!/usr/bin/python3
+
+"""
+Runs `hash_reversal` over a matrix of configs, difficulties and thread counts
+and writes one row of results per run. Run it from the build directory, where
+relative `dataset_dir` paths of the configs are resolved, e.g.
+
+    python3 ../scaling_benchmark.py ../config/sha256.yaml \
+        --difficulties 1 4 8 16 --workers 1 2 4 --output scaling
+"""
+
+import os
+import re
+import csv
+import sys
+import json
+import glob
+import shutil
+import argparse
+import statistics
+import subprocess
+import tempfile
+import time
+
+import yaml
+
+from process_stats import load_data
+
+DIFFICULTIES = [1, 4, 8, 12, 16, 17, 18, 19, 20, 21, 22, 23, 24, 32, 64]
+
+# Columns of the results table, in order
+# Runs are only compared when all of these match, `overrides` holds the --set keys
+KEY_COLUMNS = ['config', 'dataset', 'method', 'num_workers', 'num_threads', 'overrides']
+COLUMNS = KEY_COLUMNS + [
+    'difficulty', 'num_bits', 'num_test', 'returncode', 'wall_s', 'lbp_cpu_s',
+    'num_solves', 'mean_iterations', 'max_iterations', 'num_unconverged',
+    'peak_rss_mb', 'num_solved', 'input_accuracy', 'bit_accuracy'
+]
+
+# Metric --> (direction in which it gets worse, relative tolerance option)
+REGRESSIONS = {
+    'wall_s': ('higher', 'time_tol'),
+    'lbp_cpu_s': ('higher', 'time_tol'),
+    'peak_rss_mb': ('higher', 'memory_tol'),
+    'mean_iterations': ('higher', 'iteration_tol'),
+    'num_solved': ('lower', None),
+    'input_accuracy': ('lower', 'accuracy_tol'),
+}
+
+# Times below this many seconds are too noisy to flag
+MIN_TIME_DELTA = 0.05
+
+
+def parse_log(log, max_iter):
+    """
+    Collects the per-solve iterations and LBP time from the log of one run.
+    Every schedule logs exactly one convergence line per test sample, so the
+    counts are per sample. Runs which do not converge count as `max_iter`
+    iterations. The LBP times of all samples are summed, so with several
+    workers `lbp_cpu_s` is the time spent in LBP over all workers, not the
+    wall time.
+    """
+
+    iterations, lbp_cpu_s, num_unconverged, num_solved = [], 0.0, 0, 0
+
+    for line in log.splitlines():
+        m = re.search(r'converged in (\d+) iterations', line)
+        if m is None:
+            m = re.search(r'converged after \d+ message updates \(([\d.]+) sweeps\)', line)
+        if m is not None:
+            iterations.append(float(m.group(1)))
+        elif 'did not converge' in line:
+            iterations.append(float(max_iter))
+            num_unconverged += 1
+
+        m = re.search(r'LBP finished in ([\d.]+) seconds', line)
+        if m is not None:
+            lbp_cpu_s += float(m.group(1))
+
+        if 'Hashes match' in line:
+            num_solved += 1
+
+    return {
+        'lbp_cpu_s': lbp_cpu_s,
+        'num_solves': len(iterations),
+        'mean_iterations': statistics.mean(iterations) if iterations else 0.0,
+        'max_iterations': max(iterations) if iterations else 0.0,
+        'num_unconverged': num_unconverged,
+        'num_solved': num_solved
+    }
+
+
+def run_once(binary, config, workdir):
+    """
+    Runs `binary` on `config` in `workdir` and returns its exit code, log, wall
+    time and peak RSS. The child is reaped with wait4() so its own resource
+    usage is measured instead of the sum over all children.
+    """
+
+    os.makedirs(os.path.join(workdir, 'logs'), exist_ok=True)
+    log_file = os.path.join(workdir, 'stdout.log')
+
+    with open(log_file, 'w') as out:
+        start = time.monotonic()
+        proc = subprocess.Popen([binary, config], cwd=workdir, stdout=out,
+                                stderr=subprocess.STDOUT)
+        _, status, rusage = os.wait4(proc.pid, 0)
+        wall_s = time.monotonic() - start
+        proc.returncode = os.waitstatus_to_exitcode(status)
+
+    with open(log_file) as f:
+        log = f.read()
+
+    # ru_maxrss is in kilobytes on Linux
+    return proc.returncode, log, wall_s, rusage.ru_maxrss / 1024.0
+
+
+def run_case(binary, base_config, dataset_dir, overrides, repeat):
+    with open(base_config) as f:
+        config = yaml.safe_load(f)
+    config.update(overrides)
+    config['dataset_dir'] = dataset_dir
+    config['test_mode'] = False
+
+    with open(os.path.join(dataset_dir, 'params.yaml')) as f:
+        params = yaml.safe_load(f)
+
+    row = {
+        'config': os.path.basename(base_config),
+        'dataset': os.path.basename(dataset_dir),
+        'method': config['method'],
+        'num_workers': config['num_workers'],
+        'num_threads': config['num_threads'],
+        'overrides': format_overrides(overrides),
+        'difficulty': params['difficulty'],
+        'num_bits': params['num_bits_per_sample'],
+        'num_test': min(config['num_test'], params['num_samples'])
+    }
+
+    workdir = tempfile.mkdtemp(prefix='scaling_')
+    try:
+        config_file = os.path.join(workdir, 'config.yaml')
+        with open(config_file, 'w') as f:
+            yaml.dump(config, f, default_flow_style=None)
+
+        wall_times, lbp_times = [], []
+        for _ in range(repeat):
+            returncode, log, wall_s, peak_rss_mb = run_once(binary, config_file, workdir)
+            parsed = parse_log(log, config['lbp_max_iter'])
+            wall_times.append(wall_s)
+            lbp_times.append(parsed['lbp_cpu_s'])
+            if returncode != 0:
+                break
+
+        # Timings are the median over the repeats, everything else is deterministic
+        row.update(parsed)
+        row['returncode'] = returncode
+        row['wall_s'] = statistics.median(wall_times)
+        row['lbp_cpu_s'] = statistics.median(lbp_times)
+        row['peak_rss_mb'] = peak_rss_mb
+
+        stats_file = os.path.join(workdir, 'statistics.bin')
+        row['input_accuracy'] = row['bit_accuracy'] = None
+        if returncode == 0 and os.path.exists(stats_file):
+            data = load_data(stats_file)
+            accuracies = dict(zip(data['bit indices'], data['bit accuracies']))
+            inputs = [a for rv, a in accuracies.items() if rv < params['num_input_bits']]
+            if inputs:
+                row['input_accuracy'] = statistics.mean(inputs)
+            if accuracies:
+                row['bit_accuracy'] = statistics.mean(accuracies.values())
+        else:
+            print('\tRun failed with exit code {}, last lines of the log:'.format(returncode))
+            print('\n'.join('\t\t' + l for l in log.splitlines()[-5:]))
+    finally:
+        shutil.rmtree(workdir, ignore_errors=True)
+
+    return row
+
+
+def with_difficulty(dataset_dir, difficulty):
+    """ Swaps the `_d<N>` suffix of a dataset directory for another difficulty """
+    return re.sub(r'_d\d+$', '_d{}'.format(difficulty), dataset_dir.rstrip('/'))
+
+
+def parse_override(text):
+    key, sep, value = text.partition('=')
+    if not sep:
+        raise argparse.ArgumentTypeError('Expected key=value, got "{}"'.format(text))
+    return key, yaml.safe_load(value)
+
+
+def format_overrides(overrides):
+    """
+    The --set overrides of a run as sorted `key=value` pairs. The worker and
+    thread counts have their own columns and are left out.
+    """
+
+    return ' '.join('{}={}'.format(k, json.dumps(v)) for k, v in sorted(overrides.items())
+                    if k not in ('num_workers', 'num_threads'))
+
+
+def compare(rows, baseline, args):
+    """
+    Returns a description of every metric which got worse than in the
+    baseline by more than its tolerance.
+    """
+
+    # Baselines from before the `overrides` column were run without overrides
+    def key(row):
+        return tuple(row.get(c, '') for c in KEY_COLUMNS)
+
+    baseline_rows = {key(row): row for row in baseline}
+    regressions = []
+
+    for row in rows:
+        base = baseline_rows.get(key(row))
+        if base is None:
+            continue
+        name = '/'.join(str(v) for v in key(row) if v != '')
+
+        if row['returncode'] != 0 and base['returncode'] == 0:
+            regressions.append('{}: failed with exit code {}'.format(name, row['returncode']))
+            continue
+
+        for metric, (worse, tol_option) in REGRESSIONS.items():
+            new, old = row.get(metric), base.get(metric)
+            if new is None or old is None:
+                continue
+            tol = getattr(args, tol_option) if tol_option else 0.0
+            if metric == 'input_accuracy':
+                bad = new < old - tol
+            elif worse == 'higher':
+                bad = new > old * (1.0 + tol)
+                if metric.endswith('_s'):
+                    bad = bad and new - old > MIN_TIME_DELTA
+            else:
+                bad = new < old * (1.0 - tol)
+            if bad:
+                regressions.append('{}: {} {:.4g} -> {:.4g}'.format(name, metric, old, new))
+
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Hash reversal scaling benchmark')
+    parser.add_argument('configs', type=str, nargs='*',
+                        help='Config files to run, default is every file in ../config')
+    parser.add_argument('--binary', type=str, default='./hash_reversal',
+                        help='Path to the hash_reversal executable')
+    parser.add_argument('--difficulties', type=int, nargs='*', default=None,
+                        help='Run each config on the datasets of these difficulties, '
+                             'e.g. 1 to 64 SHA-256 rounds. Without values, each config '
+                             'runs on its own dataset (default: {})'.format(
+                                 ' '.join(str(d) for d in DIFFICULTIES)))
+    parser.add_argument('--workers', type=int, nargs='+', default=[1],
+                        help='Values of `num_workers` to run')
+    parser.add_argument('--threads', type=int, nargs='+', default=[1],
+                        help='Values of `num_threads` to run')
+    parser.add_argument('--set', type=parse_override, action='append', default=[],
+                        metavar='KEY=VALUE', help='Override a config key in every run')
+    parser.add_argument('--repeat', type=int, default=1,
+                        help='Runs per case, timings are the median')
+    parser.add_argument('--output', type=str, default='scaling_results',
+                        help='Writes the results to <output>.json and <output>.csv')
+    parser.add_argument('--baseline', type=str, default=None,
+                        help='Results JSON to compare against, regressions give exit code 1')
+    parser.add_argument('--save-baseline', type=str, default=None,
+                        help='Also write the results to this baseline JSON')
+    parser.add_argument('--time-tol', type=float, default=0.2,
+                        help='Allowed relative increase of the wall and LBP times')
+    parser.add_argument('--memory-tol', type=float, default=0.1,
+                        help='Allowed relative increase of the peak RSS')
+    parser.add_argument('--iteration-tol', type=float, default=0.05,
+                        help='Allowed relative increase of the mean iterations')
+    parser.add_argument('--accuracy-tol', type=float, default=0.01,
+                        help='Allowed absolute decrease of the input bit accuracy')
+    args = parser.parse_args()
+
+    binary = os.path.abspath(args.binary)
+    if not os.path.exists(binary):
+        print('Executable "{}" does not exist, run from the build directory or use --binary'
+              .format(binary))
+        return 1
+
+    configs = args.configs
+    if not configs:
+        config_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'config')
+        configs = sorted(glob.glob(os.path.join(config_dir, '*.yaml')))
+    difficulties = args.difficulties if args.difficulties is not None else DIFFICULTIES
+
+    rows = []
+    for base_config in configs:
+        with open(base_config) as f:
+            dataset_dir = os.path.abspath(yaml.safe_load(f)['dataset_dir'])
+        dataset_dirs = [dataset_dir]
+        if difficulties:
+            dataset_dirs = sorted(set(with_difficulty(dataset_dir, d) for d in difficulties),
+                                  key=lambda d: int(re.search(r'(\d+)$', d).group(1)))
+
+        for data in dataset_dirs:
+            if not os.path.exists(os.path.join(data, 'params.yaml')):
+                print('Skipping {} on missing dataset {}'.format(base_config, data))
+                continue
+
+            for workers in args.workers:
+                for threads in args.threads:
+                    overrides = dict(args.set)
+                    overrides.update({'num_workers': workers, 'num_threads': threads})
+                    print('Running {} on {} with {} workers, {} threads...'.format(
+                        os.path.basename(base_config), os.path.basename(data), workers, threads))
+                    row = run_case(binary, base_config, data, overrides, args.repeat)
+                    print('\t{:.3f} s, {:.1f} iterations, {:.1f} MB, {}/{} solved'.format(
+                        row['wall_s'], row['mean_iterations'], row['peak_rss_mb'],
+                        row['num_solved'], row['num_test']))
+                    rows.append(row)
+
+    outputs = [args.output + '.json']
+    if args.save_baseline is not None:
+        outputs.append(args.save_baseline)
+    for filename in outputs:
+        with open(filename, 'w') as f:
+            json.dump(rows, f, indent=2)
+
+    with open(args.output + '.csv', 'w', newline='') as f:
+        writer = csv.DictWriter(f, fieldnames=COLUMNS, extrasaction='ignore')
+        writer.writeheader()
+        writer.writerows(rows)
+    print('Saved {} results to: {}.json, {}.csv'.format(len(rows), args.output, args.output))
+
+    if args.baseline is not None:
+        with open(args.baseline) as f:
+            regressions = compare(rows, json.load(f), args)
+        if regressions:
+            print('{} regressions against {}:'.format(len(regressions), args.baseline))
+            for r in regressions:
+                print('\t' + r)
+            return 1
+        print('No regressions against {}'.format(args.baseline))
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
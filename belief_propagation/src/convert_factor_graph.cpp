@@ -0,0 +1,49 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+/*
+ * Converts a `factors.txt` file to the binary graph format, which
+ * `Dataset::loadFactorGraph` otherwise creates on first use.
+ *
+ * Usage: convert_factor_graph <factors.txt> [factors.bin]
+ */
+
+#include <spdlog/spdlog.h>
+
+#include <filesystem>
+#include <string>
+
+#include "hash_reversal/dataset.hpp"
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    spdlog::error("Usage: {} <factors.txt> [factors.bin]", argv[0]);
+    return 1;
+  }
+
+  const std::string graph_file = argv[1];
+  const std::string binary_file =
+      argc > 2 ? argv[2] : std::filesystem::path(graph_file).replace_extension(".bin").string();
+
+  if (!std::filesystem::exists(graph_file)) {
+    spdlog::error("'{}' does not exist", graph_file);
+    return 1;
+  }
+
+  if (!hash_reversal::Dataset::convertFactorGraph(graph_file, binary_file)) {
+    spdlog::error("Could not write '{}'", binary_file);
+    return 1;
+  }
+
+  spdlog::info("Wrote '{}'", binary_file);
+  return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+/*
+ * Generates `data.bits` for an existing dataset directory from its
+ * `factors.txt` and `params.yaml`, without the Python symbolic tracer.
+ *
+ * Usage: generate_dataset <dataset_dir> <num_samples> [num_threads] [seed]
+ *
+ * Random hash inputs are pushed through the circuit with the bitsliced
+ * simulator, 512 samples per pass, and the samples are streamed to disk in
+ * the layout `Dataset` reads: `num_bits_per_sample` bits per sample, MSB-first.
+ * RVs which were pruned from the factor graph are written as 0.
+ */
+
+#include <spdlog/spdlog.h>
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hash_reversal/circuit_simulator.hpp"
+#include "hash_reversal/dataset.hpp"
+#include "hash_reversal/topology.hpp"
+#include "utils/thread_pool.hpp"
+
+namespace {
+
+//! 64-bit words per RV and simulator pass
+constexpr size_t kWords = 8;
+
+//! Samples per block, a multiple of 8 so that every block is whole bytes
+constexpr size_t kBlockSamples = 64 * kWords;
+
+/*
+ * Simulates block `block` of `num_samples` samples into `bytes`. Each block
+ * seeds its own generator, so the output does not depend on the thread count.
+ */
+void generateBlock(const hash_reversal::CircuitSimulator &simulator, size_t num_bits,
+                   size_t num_samples, size_t block, uint64_t seed,
+                   std::vector<uint64_t> &words, std::vector<uint8_t> &bytes) {
+  const hash_reversal::Topology &graph = simulator.graph();
+  // seed_seq keeps 32 bits per value, so 64-bit values are split in two
+  std::seed_seq seq = {uint32_t(seed), uint32_t(seed >> 32), uint32_t(block),
+                       uint32_t(uint64_t(block) >> 32)};
+  std::mt19937_64 rng(seq);
+
+  words.assign(graph.numRVs() * kWords, 0);
+  for (size_t v : simulator.inputs()) {
+    for (size_t w = 0; w < kWords; ++w) words[v * kWords + w] = rng();
+  }
+  simulator.evaluate(words.data(), kWords);
+
+  const size_t first = block * kBlockSamples;
+  const size_t count = std::min(kBlockSamples, num_samples - first);
+  bytes.assign(count * num_bits / 8, 0);
+
+  size_t bit = 0;
+  for (size_t s = 0; s < count; ++s) {
+    const size_t w = s / 64, shift = s % 64;
+    for (size_t i = 0; i < num_bits; ++i, ++bit) {
+      const size_t v = graph.denseRV(i);
+      if (v != hash_reversal::Topology::npos && ((words[v * kWords + w] >> shift) & 1)) {
+        bytes[bit / 8] |= uint8_t(0x80 >> (bit % 8));
+      }
+    }
+  }
+}
+
+/*
+ * Parses a decimal argument into `value`. Returns false for anything but
+ * digits, e.g. signs or trailing text, or if it does not fit in 64 bits.
+ */
+bool parseArgument(const char *arg, uint64_t &value) {
+  char *end = nullptr;
+  errno = 0;
+  value = std::strtoull(arg, &end, 10);
+  return std::isdigit(static_cast<unsigned char>(arg[0])) && *end == '\0' && errno == 0;
+}
+
+/*
+ * Rewrites the `num_samples` line of `params.yaml`, keeping the rest as is.
+ * Returns false if the file could not be written.
+ */
+bool updateNumSamples(const std::filesystem::path &params_file, size_t num_samples) {
+  std::ifstream in(params_file);
+  std::vector<std::string> lines;
+  std::string line;
+  bool found = false;
+  while (std::getline(in, line)) {
+    if (line.rfind("num_samples:", 0) == 0) {
+      line = "num_samples: " + std::to_string(num_samples);
+      found = true;
+    }
+    lines.push_back(line);
+  }
+  in.close();
+  if (!found) lines.push_back("num_samples: " + std::to_string(num_samples));
+
+  std::ofstream out(params_file);
+  for (const auto &l : lines) out << l << std::endl;
+  out.close();
+  return bool(out);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  uint64_t num_samples = 0;
+  uint64_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+  uint64_t seed = (uint64_t(std::random_device()()) << 32) | std::random_device()();
+  if (argc < 3 || argc > 5 || !parseArgument(argv[2], num_samples) ||
+      (argc > 3 && !parseArgument(argv[3], num_threads)) ||
+      (argc > 4 && !parseArgument(argv[4], seed))) {
+    spdlog::error("Usage: {} <dataset_dir> <num_samples> [num_threads] [seed]", argv[0]);
+    return 1;
+  }
+  const std::filesystem::path dataset_dir = argv[1];
+
+  if (num_samples == 0 || num_samples % 8 != 0) {
+    spdlog::error("Number of samples is not a positive multiple of 8");
+    return 1;
+  }
+
+  const auto params_file = dataset_dir / "params.yaml";
+  const auto graph_file = dataset_dir / "factors.txt";
+  const auto data_file = dataset_dir / "data.bits";
+  if (!std::filesystem::exists(params_file) || !std::filesystem::exists(graph_file)) {
+    spdlog::error("'{}' needs both params.yaml and factors.txt", dataset_dir.string());
+    return 1;
+  }
+
+  const YAML::Node params = YAML::LoadFile(params_file.string());
+  if (!params["num_bits_per_sample"]) {
+    spdlog::error("Missing 'num_bits_per_sample' in '{}'", params_file.string());
+    return 1;
+  }
+  const size_t num_bits = params["num_bits_per_sample"].as<size_t>();
+
+  const auto graph = std::make_shared<const hash_reversal::Topology>(
+      hash_reversal::Dataset::loadFactorGraph(graph_file.string()));
+  const hash_reversal::CircuitSimulator simulator(graph);
+  spdlog::info("Simulating {} samples of {} bits with {} threads, seed {}", num_samples,
+               num_bits, num_threads, seed);
+
+  // Blocks are simulated in parallel rounds of one block per thread, and each
+  // round is written out in order before the next one starts
+  const size_t num_blocks = (num_samples + kBlockSamples - 1) / kBlockSamples;
+  utils::ThreadPool pool(num_threads);
+  std::vector<std::vector<uint64_t>> words(pool.size());
+  std::vector<std::vector<uint8_t>> bytes(pool.size());
+  std::ofstream out(data_file, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!out) {
+    spdlog::error("Could not create '{}'", data_file.string());
+    return 1;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t round = 0; round < num_blocks && out; round += pool.size()) {
+    const size_t round_blocks = std::min(pool.size(), num_blocks - round);
+    pool.parallelFor(round_blocks, [&](size_t begin, size_t end) {
+      for (size_t b = begin; b < end; ++b) {
+        generateBlock(simulator, num_bits, num_samples, round + b, seed, words[b], bytes[b]);
+      }
+    });
+    for (size_t b = 0; b < round_blocks; ++b) {
+      out.write(reinterpret_cast<const char *>(bytes[b].data()), bytes[b].size());
+    }
+  }
+  out.close();
+  const auto end = std::chrono::steady_clock::now();
+
+  // params.yaml must never claim samples which are not on disk, e.g. when the
+  // disk is full
+  if (!out) {
+    spdlog::error("Could not write '{}', params.yaml was not updated", data_file.string());
+    std::filesystem::remove(data_file);
+    return 1;
+  }
+  if (!updateNumSamples(params_file, num_samples)) {
+    spdlog::error("Could not update 'num_samples' in '{}'", params_file.string());
+    return 1;
+  }
+
+  const double seconds = std::chrono::duration<double>(end - start).count();
+  spdlog::info("Wrote '{}' in {:.3f} seconds ({:.0f} samples/s)", data_file.string(), seconds,
+               num_samples / std::max(seconds, 1e-9));
+  return 0;
+}
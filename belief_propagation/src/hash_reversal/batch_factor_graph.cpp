@@ -0,0 +1,201 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "hash_reversal/batch_factor_graph.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "utils/memory.hpp"
+#include "utils/profiler.hpp"
+
+namespace hash_reversal {
+
+BatchFactorGraph::BatchFactorGraph(std::shared_ptr<Probability> prob,
+                                   std::shared_ptr<Dataset> dataset,
+                                   std::shared_ptr<utils::Config> config,
+                                   std::shared_ptr<const Topology> graph)
+    : InferenceTool(prob, dataset, config, graph),
+      kernels_(supportedBatchKernels().front()),
+      num_lanes_(0),
+      stride_(0),
+      first_sweep_(true) {
+  if (config_->lbp_schedule != "serial") {
+    spdlog::warn("LBP schedule '{}' is not supported by lbp_batch, using 'serial'",
+                 config_->lbp_schedule);
+  }
+
+  rv_offsets_.resize(graph_->numRVs() + 1, 0);
+  for (size_t v = 0; v < graph_->numRVs(); ++v) rv_offsets_[v + 1] = graph_->rvEnd(v);
+  edge_rvs_.resize(graph_->numEdges());
+  for (size_t e = 0; e < graph_->numEdges(); ++e) edge_rvs_[e] = graph_->edgeRV(e);
+
+  // Factors of the same type run through the same kernel one after another
+  const FactorType types[] = {FactorType::AND, FactorType::INV, FactorType::SAME,
+                              FactorType::PRIOR};
+  for (FactorType type : types) {
+    std::vector<size_t> first_edges;
+    for (size_t f = 0; f < graph_->numFactors(); ++f) {
+      if (graph_->factorType(f) == type) first_edges.push_back(graph_->factorBegin(f));
+    }
+    if (first_edges.empty()) continue;
+    first_edges_.push_back(std::move(first_edges));
+    factors_.push_back({type, first_edges_.back().size(), first_edges_.back().data(),
+                        prob_->table(type, UNOBSERVED), prob_->table(type, OBSERVED_ZERO),
+                        prob_->table(type, OBSERVED_ONE)});
+  }
+}
+
+InferenceTool::Prediction BatchFactorGraph::predict(size_t v, size_t lane) const {
+  const size_t rv_index = graph_->rvIndex(v);
+  InferenceTool::Prediction prediction(rv_index, 0.5);
+  double msg0 = 1.0, msg1 = 1.0;
+  const auto &rv_edges = graph_->rvEdges();
+
+  for (size_t i = graph_->rvBegin(v); i < graph_->rvEnd(v); ++i) {
+    const double *msg = &factor_msgs_[2 * rv_edges[i] * stride_ + lane];
+    msg0 *= msg[0];
+    msg1 *= msg[stride_];
+  }
+
+  if (msg0 + msg1 == 0) {
+    spdlog::warn("Prediction for RV {} would divide by zero!", rv_index);
+  } else {
+    prediction.prob_one = msg1 / (msg0 + msg1);
+  }
+
+  return prediction;
+}
+
+std::vector<InferenceTool::Prediction> BatchFactorGraph::marginals() const {
+  return marginals(0);
+}
+
+std::vector<InferenceTool::Prediction> BatchFactorGraph::marginals(size_t lane) const {
+  std::vector<InferenceTool::Prediction> predictions;
+  predictions.reserve(graph_->numFactors());
+  for (size_t f = 0; f < graph_->numFactors(); ++f) {
+    predictions.push_back(predict(graph_->factorOutput(f), lane));
+  }
+  return predictions;
+}
+
+size_t BatchFactorGraph::memoryBytes() const {
+  using utils::Memory;
+  size_t bytes = InferenceTool::memoryBytes() + Memory::bytes(rv_offsets_) +
+                 Memory::bytes(edge_rvs_) + Memory::bytes(factor_msgs_) + Memory::bytes(rv_msgs_) +
+                 Memory::bytes(observed_lanes_) + Memory::bytes(active_) +
+                 Memory::bytes(deltas_) + Memory::bytes(iterations_);
+  for (const auto &first_edges : first_edges_) bytes += Memory::bytes(first_edges);
+  return bytes;
+}
+
+void BatchFactorGraph::reconfigure(const VariableAssignments &observed) {
+  reconfigure(std::vector<VariableAssignments>{observed});
+}
+
+void BatchFactorGraph::reconfigure(const std::vector<VariableAssignments> &observed) {
+  const size_t num_rvs = graph_->numRVs();
+  num_lanes_ = observed.size();
+  stride_ = std::max<size_t>(1, (num_lanes_ + kChunkLanes - 1) / kChunkLanes) * kChunkLanes;
+  const size_t num_chunks = stride_ / kChunkLanes;
+
+  observed_lanes_.assign(2 * num_rvs * num_chunks, 0);
+  for (size_t lane = 0; lane < num_lanes_; ++lane) {
+    setObserved(observed[lane]);
+    const uint8_t bit = uint8_t(1) << (lane % kChunkLanes);
+    for (size_t v = 0; v < num_rvs; ++v) {
+      if (rv_obs_[v] == UNOBSERVED) continue;
+      observed_lanes_[(2 * v + rv_obs_[v]) * num_chunks + lane / kChunkLanes] |= bit;
+    }
+  }
+
+  // The lanes which pad the last chunk never run
+  active_.assign(num_chunks, 0);
+  for (size_t lane = 0; lane < num_lanes_; ++lane) {
+    active_[lane / kChunkLanes] |= uint8_t(1) << (lane % kChunkLanes);
+  }
+
+  factor_msgs_.assign(2 * graph_->numEdges() * stride_, 1.0);
+  rv_msgs_.assign(2 * graph_->numEdges() * stride_, 1.0);
+  deltas_.assign(stride_, 0.0);
+  iterations_.assign(num_lanes_, config_->lbp_max_iter);
+  first_sweep_ = true;
+}
+
+void BatchFactorGraph::solve() {
+  PROFILE_SCOPE("solve");
+  spdlog::info("\tStarting batched loopy BP on {} samples ({} kernels)...", num_lanes_,
+               kernels_.name);
+  const auto start = std::chrono::steady_clock::now();
+
+  BatchSweep sweep = {stride_,
+                      graph_->numRVs(),
+                      rv_offsets_.data(),
+                      graph_->rvEdges().data(),
+                      edge_rvs_.data(),
+                      factors_.data(),
+                      factors_.size(),
+                      observed_lanes_.data(),
+                      active_.data(),
+                      config_->lbp_damping,
+                      first_sweep_,
+                      factor_msgs_.data(),
+                      rv_msgs_.data(),
+                      deltas_.data()};
+
+  // A lane stops once the largest change of its messages in an iteration is
+  // within the tolerance, the batch once every lane has stopped
+  std::vector<char> invalid(num_lanes_, false);
+  size_t num_active = num_lanes_;
+  for (size_t itr = 0; itr < config_->lbp_max_iter && num_active > 0; ++itr) {
+    PROFILE_SCOPE("lbp_iteration");
+    std::fill(deltas_.begin(), deltas_.end(), 0.0);
+    sweep.first_sweep = first_sweep_;
+    kernels_.updateRandomVariables(sweep);
+    kernels_.updateFactors(sweep);
+    first_sweep_ = false;
+    PROFILE_COUNT("messages_updated", 2 * graph_->numEdges() * num_active);
+
+    for (size_t lane = 0; lane < num_lanes_; ++lane) {
+      uint8_t &chunk = active_[lane / kChunkLanes];
+      const uint8_t bit = uint8_t(1) << (lane % kChunkLanes);
+      if (!(chunk & bit)) continue;
+      if (std::isinf(deltas_[lane])) invalid[lane] = true;
+      if (deltas_[lane] <= convergence_tol) {
+        chunk &= uint8_t(~bit);
+        iterations_[lane] = itr + 1;
+        --num_active;
+      }
+    }
+  }
+
+  // Every lane logs like a serial solve, so the log has one line per sample
+  for (size_t lane = 0; lane < num_lanes_; ++lane) {
+    PROFILE_VALUE("lbp_iterations", iterations_[lane]);
+    if (invalid[lane]) {
+      spdlog::warn("\tSome messages were all zeros or not finite and were not updated.");
+    }
+    if (active_[lane / kChunkLanes] & (uint8_t(1) << (lane % kChunkLanes))) {
+      spdlog::warn("\tLoopy BP did not converge, max iterations reached.");
+    } else {
+      spdlog::info("\tLoopy BP converged in {} iterations", iterations_[lane]);
+    }
+  }
+
+  spdlog::info("\tLBP finished in {:.3f} seconds.", utils::Convenience::seconds_since(start));
+}
+
+}  // end namespace hash_reversal
@@ -0,0 +1,68 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "hash_reversal/batch_kernels.hpp"
+
+#include <cmath>
+#include <limits>
+
+namespace hash_reversal {
+
+namespace {
+
+//! One lane at a time, for CPUs without AVX2
+struct Lanes {
+  struct Mask {
+    bool m;
+    Mask operator&(Mask o) const { return {m && o.m}; }
+    Mask operator~() const { return {!m}; }
+  };
+
+  static constexpr size_t kWidth = 1;
+  double v;
+
+  static Lanes load(const double *p) { return {*p}; }
+  void store(double *p) const { *p = v; }
+  static Lanes set1(double x) { return {x}; }
+  static double infinity() { return std::numeric_limits<double>::infinity(); }
+
+  //! Lane `k` of a chunk's flags
+  static Mask mask(uint8_t bits, size_t k) { return {((bits >> k) & 1) != 0}; }
+  static Mask positiveFinite(Lanes x) { return {x.v > 0.0 && std::isfinite(x.v)}; }
+  static Lanes select(Mask m, Lanes a, Lanes b) { return m.m ? a : b; }
+  static Lanes abs(Lanes x) { return {std::abs(x.v)}; }
+  static Lanes max(Lanes a, Lanes b) { return b.v > a.v ? b : a; }
+
+  friend Lanes operator+(Lanes a, Lanes b) { return {a.v + b.v}; }
+  friend Lanes operator-(Lanes a, Lanes b) { return {a.v - b.v}; }
+  friend Lanes operator*(Lanes a, Lanes b) { return {a.v * b.v}; }
+  friend Lanes operator/(Lanes a, Lanes b) { return {a.v / b.v}; }
+};
+
+}  // namespace
+
+BatchKernels scalarBatchKernels() {
+  return {"scalar", batch::updateRandomVariables<Lanes>, batch::updateFactors<Lanes>};
+}
+
+std::vector<BatchKernels> supportedBatchKernels() {
+  std::vector<BatchKernels> kernels;
+#ifdef HASH_REVERSAL_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) kernels.push_back(avx512BatchKernels());
+  if (__builtin_cpu_supports("avx2")) kernels.push_back(avx2BatchKernels());
+#endif
+  kernels.push_back(scalarBatchKernels());
+  return kernels;
+}
+
+}  // end namespace hash_reversal
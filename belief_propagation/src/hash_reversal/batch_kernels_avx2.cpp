@@ -0,0 +1,69 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+// Compiled with -mavx2 and only called on CPUs which support it
+
+#include <immintrin.h>
+
+#include "hash_reversal/batch_kernels.hpp"
+
+namespace hash_reversal {
+
+namespace {
+
+//! Four lanes in a 256-bit register, half a chunk
+struct Lanes {
+  struct Mask {
+    __m256d m;
+    Mask operator&(Mask o) const { return {_mm256_and_pd(m, o.m)}; }
+    Mask operator~() const {
+      return {_mm256_xor_pd(m, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)))};
+    }
+  };
+
+  static constexpr size_t kWidth = 4;
+  __m256d v;
+
+  static Lanes load(const double *p) { return {_mm256_loadu_pd(p)}; }
+  void store(double *p) const { _mm256_storeu_pd(p, v); }
+  static Lanes set1(double x) { return {_mm256_set1_pd(x)}; }
+  static double infinity() { return __builtin_inf(); }
+
+  //! Lanes `k` to `k + 3` of a chunk's flags
+  static Mask mask(uint8_t bits, size_t k) {
+    const __m256i bit = _mm256_set_epi64x(8, 4, 2, 1);
+    const __m256i set = _mm256_and_si256(_mm256_set1_epi64x((bits >> k) & 0xf), bit);
+    return {_mm256_castsi256_pd(_mm256_cmpeq_epi64(set, bit))};
+  }
+
+  static Mask positiveFinite(Lanes x) {
+    return {_mm256_and_pd(_mm256_cmp_pd(x.v, _mm256_setzero_pd(), _CMP_GT_OQ),
+                          _mm256_cmp_pd(x.v, _mm256_set1_pd(infinity()), _CMP_LT_OQ))};
+  }
+
+  static Lanes select(Mask m, Lanes a, Lanes b) { return {_mm256_blendv_pd(b.v, a.v, m.m)}; }
+  static Lanes abs(Lanes x) { return {_mm256_andnot_pd(_mm256_set1_pd(-0.0), x.v)}; }
+  static Lanes max(Lanes a, Lanes b) { return {_mm256_max_pd(b.v, a.v)}; }
+
+  friend Lanes operator+(Lanes a, Lanes b) { return {_mm256_add_pd(a.v, b.v)}; }
+  friend Lanes operator-(Lanes a, Lanes b) { return {_mm256_sub_pd(a.v, b.v)}; }
+  friend Lanes operator*(Lanes a, Lanes b) { return {_mm256_mul_pd(a.v, b.v)}; }
+  friend Lanes operator/(Lanes a, Lanes b) { return {_mm256_div_pd(a.v, b.v)}; }
+};
+
+}  // namespace
+
+BatchKernels avx2BatchKernels() {
+  return {"avx2", batch::updateRandomVariables<Lanes>, batch::updateFactors<Lanes>};
+}
+
+}  // end namespace hash_reversal
@@ -0,0 +1,60 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+// Compiled with -mavx512f and only called on CPUs which support it
+
+#include <immintrin.h>
+
+#include "hash_reversal/batch_kernels.hpp"
+
+namespace hash_reversal {
+
+namespace {
+
+//! Eight lanes in a 512-bit register, a whole chunk
+struct Lanes {
+  typedef __mmask8 Mask;
+
+  static constexpr size_t kWidth = 8;
+  __m512d v;
+
+  static Lanes load(const double *p) { return {_mm512_loadu_pd(p)}; }
+  void store(double *p) const { _mm512_storeu_pd(p, v); }
+  static Lanes set1(double x) { return {_mm512_set1_pd(x)}; }
+  static double infinity() { return __builtin_inf(); }
+
+  //! The flags of a chunk are already a lane mask
+  static Mask mask(uint8_t bits, size_t) { return bits; }
+
+  static Mask positiveFinite(Lanes x) {
+    return _mm512_cmp_pd_mask(x.v, _mm512_setzero_pd(), _CMP_GT_OQ) &
+           _mm512_cmp_pd_mask(x.v, _mm512_set1_pd(infinity()), _CMP_LT_OQ);
+  }
+
+  static Lanes select(Mask m, Lanes a, Lanes b) { return {_mm512_mask_blend_pd(m, b.v, a.v)}; }
+  static Lanes abs(Lanes x) { return {_mm512_abs_pd(x.v)}; }
+  //! The masked form, as GCC 12 warns about the undefined source of _mm512_max_pd
+  static Lanes max(Lanes a, Lanes b) { return {_mm512_mask_max_pd(b.v, 0xff, b.v, a.v)}; }
+
+  friend Lanes operator+(Lanes a, Lanes b) { return {_mm512_add_pd(a.v, b.v)}; }
+  friend Lanes operator-(Lanes a, Lanes b) { return {_mm512_sub_pd(a.v, b.v)}; }
+  friend Lanes operator*(Lanes a, Lanes b) { return {_mm512_mul_pd(a.v, b.v)}; }
+  friend Lanes operator/(Lanes a, Lanes b) { return {_mm512_div_pd(a.v, b.v)}; }
+};
+
+}  // namespace
+
+BatchKernels avx512BatchKernels() {
+  return {"avx512", batch::updateRandomVariables<Lanes>, batch::updateFactors<Lanes>};
+}
+
+}  // end namespace hash_reversal
@@ -0,0 +1,75 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "hash_reversal/circuit_simulator.hpp"
+
+#include <spdlog/spdlog.h>
+
+namespace hash_reversal {
+
+CircuitSimulator::CircuitSimulator(std::shared_ptr<const Topology> graph) : graph_(graph) {
+  size_t num_unsupported = 0;
+
+  for (size_t f : graph_->levelFactors()) {
+    const size_t begin = graph_->factorBegin(f);
+    const size_t n = graph_->factorEnd(f) - begin;
+    const FactorType type = graph_->factorType(f);
+    Instruction instr = {type, uint32_t(graph_->edgeRV(begin)), 0, 0};
+    if (n > 1) instr.in1 = instr.in2 = uint32_t(graph_->edgeRV(begin + 1));
+    if (n > 2) instr.in2 = uint32_t(graph_->edgeRV(begin + 2));
+
+    switch (type) {
+      case FactorType::PRIOR:
+        inputs_.push_back(instr.out);
+        break;
+      case FactorType::INV:
+      case FactorType::SAME:
+      case FactorType::AND:
+        instructions_.push_back(instr);
+        break;
+      case FactorType::UNSUPPORTED:
+        ++num_unsupported;
+        break;
+    }
+  }
+
+  if (num_unsupported > 0) {
+    spdlog::warn("Circuit simulator skips {} unsupported factors", num_unsupported);
+  }
+}
+
+void CircuitSimulator::evaluate(uint64_t *words, size_t num_words) const {
+  const size_t W = num_words;
+
+  for (const Instruction &instr : instructions_) {
+    uint64_t *out = words + instr.out * W;
+    const uint64_t *in1 = words + instr.in1 * W;
+    const uint64_t *in2 = words + instr.in2 * W;
+
+    switch (instr.type) {
+      case FactorType::INV:
+        for (size_t w = 0; w < W; ++w) out[w] = ~in1[w];
+        break;
+      case FactorType::SAME:
+        for (size_t w = 0; w < W; ++w) out[w] = in1[w];
+        break;
+      case FactorType::AND:
+        for (size_t w = 0; w < W; ++w) out[w] = in1[w] & in2[w];
+        break;
+      case FactorType::PRIOR:
+      case FactorType::UNSUPPORTED:
+        break;
+    }
+  }
+}
+
+}  // end namespace hash_reversal
@@ -0,0 +1,100 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "hash_reversal/column_store.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace hash_reversal {
+
+namespace {
+
+/*
+ * Transposes a 64x64 bit matrix in place, where bit 63 - j of `a[i]` is
+ * element (i, j). See "Hacker's Delight", section 7-3.
+ */
+void transpose64(uint64_t *a) {
+  uint64_t m = 0x00000000FFFFFFFFull;
+  for (size_t j = 32; j != 0; j >>= 1, m ^= m << j) {
+    for (size_t k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+      const uint64_t t = (a[k] ^ (a[k | j] >> j)) & m;
+      a[k] ^= t;
+      a[k | j] ^= t << j;
+    }
+  }
+}
+
+}  // namespace
+
+ColumnStore::ColumnStore(const Dataset &dataset, const std::vector<size_t> &rv_indices,
+                         size_t begin, size_t end)
+    : num_samples_(end - begin), num_words_((num_samples_ + 63) / 64) {
+  size_t max_rv = 0;
+  for (size_t rv : rv_indices) max_rv = std::max(max_rv, rv);
+  columns_.assign(rv_indices.empty() ? 0 : max_rv + 1, npos);
+
+  // Sample words that contain at least one requested RV
+  size_t num_columns = 0;
+  std::vector<size_t> words;
+  for (size_t rv : rv_indices) {
+    if (columns_[rv] != npos) continue;
+    columns_[rv] = num_columns++;
+    words.push_back(rv / SampleView::kWordBits);
+  }
+  std::sort(words.begin(), words.end());
+  words.erase(std::unique(words.begin(), words.end()), words.end());
+  bits_.assign(num_columns * num_words_, 0);
+
+  // Each block of 64 samples and 64 RVs is one bit matrix transpose. The
+  // samples go in reverse, so that sample k ends up as bit k of a column word.
+  std::vector<SampleView> samples(SampleView::kWordBits);
+  uint64_t matrix[64];
+  for (size_t b = 0; b < num_words_; ++b) {
+    const size_t first = begin + b * 64;
+    const size_t count = std::min<size_t>(64, end - first);
+    for (size_t k = 0; k < count; ++k) samples[k] = dataset.getFullSample(first + k);
+
+    for (size_t w : words) {
+      for (size_t k = 0; k < 64; ++k) matrix[63 - k] = k < count ? samples[k].word(w) : 0;
+      transpose64(matrix);
+
+      // Row j of the transpose holds bit j of the sample word
+      const size_t first_rv = w * SampleView::kWordBits;
+      const size_t last_rv = std::min(columns_.size(), first_rv + SampleView::kWordBits);
+      for (size_t rv = first_rv; rv < last_rv; ++rv) {
+        if (columns_[rv] != npos) bits_[columns_[rv] * num_words_ + b] = matrix[rv - first_rv];
+      }
+    }
+  }
+}
+
+bool ColumnStore::contains(size_t rv_index) const {
+  return rv_index < columns_.size() && columns_[rv_index] != npos;
+}
+
+const uint64_t *ColumnStore::column(size_t rv_index) const {
+  if (!contains(rv_index)) {
+    throw std::out_of_range("RV " + std::to_string(rv_index) + " is not a loaded column");
+  }
+  return bits_.data() + columns_[rv_index] * num_words_;
+}
+
+size_t ColumnStore::countOnes(size_t rv_index) const {
+  const uint64_t *bits = column(rv_index);
+  size_t count = 0;
+  for (size_t w = 0; w < num_words_; ++w) count += __builtin_popcountll(bits[w]);
+  return count;
+}
+
+}  // end namespace hash_reversal
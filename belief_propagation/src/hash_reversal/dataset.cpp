@@ -14,84 +14,409 @@
 
 #include <spdlog/spdlog.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+#include "hash_reversal/column_store.hpp"
+#include "utils/memory.hpp"
+#include "utils/profiler.hpp"
+#include "utils/thread_pool.hpp"
 
 namespace hash_reversal {
 
-Dataset::Dataset(std::shared_ptr<utils::Config> config) : config_(config) {
+namespace {
+
+//! Bytes of the samples read at once in streaming mode
+constexpr size_t kWindowBytes = size_t(1) << 22;
+
+/*
+ * Copies the `n` bits of `data` starting at `first_bit` into word-aligned
+ * `out`, reading 0 past the end of `data` and clearing the unused bits of the
+ * last word.
+ */
+void unpackSample(const unsigned char *data, size_t data_size, size_t first_bit, size_t n,
+                  unsigned char *out) {
+  // Bits [bit, bit + 64) of the data as a word
+  const auto load_bits = [&](size_t bit) {
+    const size_t byte = bit / 8, shift = bit % 8;
+    uint64_t word = 0;
+    if (byte + sizeof(uint64_t) <= data_size) {
+      word = SampleView::loadWord(data + byte);
+    } else {
+      for (size_t b = 0; b < sizeof(uint64_t); ++b) {
+        word = (word << 8) | (byte + b < data_size ? data[byte + b] : 0);
+      }
+    }
+    if (shift == 0) return word;
+    const size_t next = byte + sizeof(uint64_t);
+    return (word << shift) | ((next < data_size ? data[next] : 0) >> (8 - shift));
+  };
+
+  const size_t num_words = (n + SampleView::kWordBits - 1) / SampleView::kWordBits;
+  const size_t tail_bits = n % SampleView::kWordBits;
+  const uint64_t tail_mask = tail_bits ? ~uint64_t(0) << (SampleView::kWordBits - tail_bits)
+                                       : ~uint64_t(0);
+
+  for (size_t w = 0; w < num_words; ++w) {
+    uint64_t word = load_bits(first_bit + w * SampleView::kWordBits);
+    if (w + 1 == num_words) word &= tail_mask;
+    SampleView::storeWord(word, out + w * sizeof(uint64_t));
+  }
+}
+
+}  // namespace
+
+Dataset::Dataset(std::shared_ptr<utils::Config> config)
+    : config_(config),
+      num_selected_(0),
+      mapped_(nullptr),
+      mapped_size_(0),
+      samples_(nullptr),
+      row_bytes_(0),
+      in_place_(false),
+      fd_(-1),
+      file_size_(0),
+      window_samples_(0),
+      max_windows_(0) {
+  PROFILE_SCOPE("dataset");
   spdlog::info("Loading dataset...");
-  const auto start = utils::Convenience::time_since_epoch();
+  const auto start = std::chrono::steady_clock::now();
 
   const size_t N = config->num_samples;
   const size_t n = config->num_bits_per_sample;
-  samples_.reserve(N);
-  for (size_t i = 0; i < N; ++i) {
-    samples_.push_back(boost::dynamic_bitset<>(n));
-  }
-
-  std::ifstream data(config->data_file, std::ios::in | std::ios::binary);
-  char c;
-  size_t i = 0;
-
-  while (i < n * N) {
-    data.get(c);
-    for (size_t j = 0; j < 8; ++j) {
-      const bool bit_val = (c >> (7 - j)) & 1;
-      const size_t row = i / n;
-      const size_t col = i - (row * n);
-      samples_.at(row)[col] = bit_val;
-      ++i;
-    }
+  const size_t expected_size = (n * N + 7) / 8;
+  const size_t num_words = (n + SampleView::kWordBits - 1) / SampleView::kWordBits;
+
+  if (config->sample_offset < N) {
+    num_selected_ = (N - config->sample_offset + config->sample_stride - 1) / config->sample_stride;
   }
 
-  if (data.get(c)) {
+  fd_ = ::open(config->data_file.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd_ >= 0 && ::fstat(fd_, &st) == 0) file_size_ = st.st_size;
+
+  if (fd_ < 0) {
+    spdlog::error("Could not open data file '{}'", config->data_file);
+  } else if (file_size_ > expected_size) {
     spdlog::warn("Data file was not 100% read, results are likely garbage.");
-  } else if (!data.eof()) {
-    spdlog::warn("Reading from data file did not reach EOF");
+  } else if (file_size_ < expected_size) {
+    spdlog::warn("Data file is too small for {} samples, missing bits are 0", N);
   }
 
-  data.close();
+  if (config->dataset_streaming) {
+    // Samples are read lazily, one window at a time, with the next window of
+    // each worker read ahead in the background
+    row_bytes_ = num_words * sizeof(uint64_t);
+    window_samples_ = std::max<size_t>(1, kWindowBytes / row_bytes_);
+    max_windows_ = 2 * std::max<size_t>(1, config->num_workers);
+    spdlog::info("Streaming {} samples in windows of {}", num_selected_, window_samples_);
+    return;
+  }
+
+  if (fd_ >= 0 && file_size_ > 0) {
+    void *mapped = ::mmap(nullptr, file_size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (mapped != MAP_FAILED) {
+      mapped_ = mapped;
+      mapped_size_ = file_size_;
+    } else {
+      spdlog::error("Could not map data file '{}'", config->data_file);
+    }
+  }
+  if (fd_ >= 0) ::close(fd_);
+  fd_ = -1;
+
+  const auto data = static_cast<const unsigned char *>(mapped_);
+  if (n % SampleView::kWordBits == 0 && mapped_size_ >= expected_size) {
+    // Every sample starts at a word boundary, so the file is used in place
+    samples_ = data;
+    row_bytes_ = n / 8;
+    in_place_ = true;
+  } else {
+    // Realign the selected samples to word boundaries
+    buffer_.assign(num_selected_ * num_words, 0);
+    samples_ = reinterpret_cast<const unsigned char *>(buffer_.data());
+    row_bytes_ = num_words * sizeof(uint64_t);
+    auto out = reinterpret_cast<unsigned char *>(buffer_.data());
+
+    // Pages of the file before the current sample are dropped as we go, so
+    // that the file and its copy are never resident at the same time
+    const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t released = 0;
+    for (size_t i = 0; i < num_selected_; ++i) {
+      const size_t first_bit = sampleIndexInFile(i) * n;
+      const size_t done = first_bit / 8 / page_size * page_size;
+      if (mapped_ && done >= released + kWindowBytes) {
+        ::madvise(static_cast<char *>(mapped_) + released, done - released, MADV_DONTNEED);
+        released = done;
+      }
+      unpackSample(data, mapped_size_, first_bit, n, out + i * row_bytes_);
+    }
+
+    if (mapped_) ::munmap(mapped_, mapped_size_);
+    mapped_ = nullptr;
+    mapped_size_ = 0;
+  }
 
-  const auto end = utils::Convenience::time_since_epoch();
-  spdlog::info("Finished loading dataset in {} seconds.", end - start);
+  spdlog::info("Finished loading dataset in {:.3f} seconds.",
+               utils::Convenience::seconds_since(start));
 }
 
-Dataset::Graph Dataset::loadFactorGraph() const {
-  std::ifstream data;
-  data.open(config_->graph_file);
-  std::string line;
+Dataset::~Dataset() {
+  // Wait for pending reads before closing the file they read from
+  for (auto &window : windows_) window.second.wait();
+  for (auto &future : pending_evicted_) future.wait();
+  windows_.clear();
+  pending_evicted_.clear();
+  if (mapped_) ::munmap(mapped_, mapped_size_);
+  if (fd_ >= 0) ::close(fd_);
+}
 
-  std::map<size_t, RandomVariable> rvs;
-  std::map<size_t, Factor> factors;
+size_t Dataset::numSamples() const { return num_selected_; }
 
-  while (std::getline(data, line)) {
-    std::stringstream line_stream(line);
-    std::string tmp;
+size_t Dataset::mappedBytes() const { return mapped_size_; }
 
-    std::getline(line_stream, tmp, ';');
-    const std::string factor_type = tmp;
+size_t Dataset::memoryBytes() const {
+  size_t bytes = utils::Memory::bytes(buffer_);
 
-    std::getline(line_stream, tmp, ';');
-    const size_t output_rv = std::stoul(tmp);
-    std::set<size_t> referenced_rvs = {output_rv};
-    rvs[output_rv].factor_indices.insert(output_rv);
+  std::lock_guard<std::mutex> lock(windows_mutex_);
+  for (const auto &window : windows_) {
+    const auto &future = window.second;
+    if (future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+      bytes += utils::Memory::bytes(*future.get());
+    }
+  }
+  return bytes;
+}
 
-    while (std::getline(line_stream, tmp, ';')) {
-      const size_t input_rv = std::stoul(tmp);
-      referenced_rvs.insert(input_rv);
-      rvs[input_rv].factor_indices.insert(output_rv);
+size_t Dataset::sampleIndexInFile(size_t sample_index) const {
+  return config_->sample_offset + sample_index * config_->sample_stride;
+}
+
+Dataset::Window Dataset::readWindow(size_t window) const {
+  const size_t n = config_->num_bits_per_sample;
+  const size_t first = window * window_samples_;
+  const size_t count = std::min(window_samples_, num_selected_ - first);
+  const size_t num_words = row_bytes_ / sizeof(uint64_t);
+  auto buffer = std::make_shared<std::vector<uint64_t>>(count * num_words, 0);
+  auto out = reinterpret_cast<unsigned char *>(buffer->data());
+
+  // Reads the bytes [begin, end) of the file, which are 0 past its end
+  std::vector<unsigned char> bytes;
+  const auto read_bytes = [&](size_t begin, size_t end) {
+    bytes.assign(end - begin, 0);
+    size_t done = 0;
+    while (begin + done < std::min(end, file_size_)) {
+      const ssize_t r = ::pread(fd_, bytes.data() + done, end - begin - done, begin + done);
+      if (r <= 0) break;
+      done += r;
     }
+  };
 
-    if (factor_type == "AND" && referenced_rvs.size() < 3u) {
-      spdlog::warn("AND factor may reference the same RV twice as an input");
+  // Consecutive samples are read with a single call, strided ones one by one
+  const size_t group = config_->sample_stride == 1 ? count : 1;
+  for (size_t g = 0; g < count; g += group) {
+    const size_t first_bit = sampleIndexInFile(first + g) * n;
+    const size_t end_bit = (sampleIndexInFile(first + g + group - 1) + 1) * n;
+    read_bytes(first_bit / 8, (end_bit + 7) / 8);
+    for (size_t i = g; i < g + group; ++i) {
+      const size_t bit = sampleIndexInFile(first + i) * n - (first_bit / 8) * 8;
+      unpackSample(bytes.data(), bytes.size(), bit, n, out + i * row_bytes_);
     }
+  }
+
+  return buffer;
+}
 
-    factors[output_rv] = Factor(factor_type, output_rv, referenced_rvs);
+Dataset::Window Dataset::getWindow(size_t window) const {
+  std::shared_future<Window> result;
+  std::list<std::shared_future<Window>> evicted;
+
+  {
+    std::lock_guard<std::mutex> lock(windows_mutex_);
+    const auto find = [&](size_t w) {
+      return std::find_if(windows_.begin(), windows_.end(),
+                          [w](const auto &entry) { return entry.first == w; });
+    };
+
+    // The most recently used windows are at the front
+    const auto it = find(window);
+    if (it != windows_.end()) {
+      windows_.splice(windows_.begin(), windows_, it);
+    } else {
+      windows_.emplace_front(window, std::async(std::launch::async, [this, window]() {
+                                       return readWindow(window);
+                                     }).share());
+    }
+    result = windows_.front().second;
+
+    const size_t next = window + 1;
+    if (next * window_samples_ < num_selected_ && find(next) == windows_.end()) {
+      windows_.emplace_front(next, std::async(std::launch::async, [this, next]() {
+                                     return readWindow(next);
+                                   }).share());
+    }
+
+    // Views of evicted windows keep them alive until they are destroyed.
+    // Reads which are still running are parked so that this thread does not
+    // wait for them, and the finished ones are released after the lock.
+    const auto is_ready = [](const std::shared_future<Window> &future) {
+      return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    };
+    while (windows_.size() > max_windows_) {
+      pending_evicted_.push_back(std::move(windows_.back().second));
+      windows_.pop_back();
+    }
+    for (auto it = pending_evicted_.begin(); it != pending_evicted_.end();) {
+      auto next_it = std::next(it);
+      if (is_ready(*it)) evicted.splice(evicted.end(), pending_evicted_, it);
+      it = next_it;
+    }
   }
 
+  return result.get();
+}
+
+Topology Dataset::loadFactorGraph() const { return loadFactorGraph(config_->graph_file); }
+
+Topology Dataset::loadFactorGraph(const std::string &graph_file) {
+  // The text is always read, to compare its checksum with the cached graph
+  std::ifstream data(graph_file, std::ios::in | std::ios::binary);
+  const std::string text((std::istreambuf_iterator<char>(data)),
+                         std::istreambuf_iterator<char>());
   data.close();
-  return {rvs, factors};
+
+  const uint64_t checksum = utils::Convenience::checksum(text);
+  const std::string cache_file = std::filesystem::path(graph_file).replace_extension(".bin");
+
+  Topology graph;
+  if (graph.load(cache_file, checksum)) {
+    spdlog::info("\tLoaded cached factor graph '{}'", cache_file);
+    return graph;
+  }
+
+  graph = parseFactorGraph(text);
+  if (graph.save(cache_file, checksum)) {
+    spdlog::info("\tCached factor graph in '{}'", cache_file);
+  } else {
+    spdlog::warn("\tCould not cache factor graph in '{}'", cache_file);
+  }
+  return graph;
+}
+
+bool Dataset::convertFactorGraph(const std::string &graph_file,
+                                 const std::string &binary_file) {
+  std::ifstream data(graph_file, std::ios::in | std::ios::binary);
+  if (!data) return false;
+  const std::string text((std::istreambuf_iterator<char>(data)),
+                         std::istreambuf_iterator<char>());
+  data.close();
+
+  return parseFactorGraph(text).save(binary_file, utils::Convenience::checksum(text));
+}
+
+Topology Dataset::parseFactorGraph(const std::string &text) {
+  // Split the text into one chunk of whole lines per thread
+  utils::ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+  const size_t num_chunks = pool.size();
+  std::vector<size_t> bounds(num_chunks + 1, text.size());
+  bounds[0] = 0;
+  for (size_t c = 1; c < num_chunks; ++c) {
+    const size_t pos = text.find('\n', std::max(bounds[c - 1], text.size() * c / num_chunks));
+    bounds[c] = pos == std::string::npos ? text.size() : pos + 1;
+  }
+
+  std::vector<std::vector<Factor>> chunks(num_chunks);
+  pool.parallelFor(num_chunks, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c) chunks[c] = parseFactors(text, bounds[c], bounds[c + 1]);
+  });
+
+  // Later lines win if an RV is the output of more than one factor
+  std::map<size_t, Factor> factors;
+  for (auto &chunk : chunks) {
+    for (auto &factor : chunk) factors[factor.output_rv] = std::move(factor);
+  }
+
+  return Topology(factors);
+}
+
+std::vector<Factor> Dataset::parseFactors(const std::string &text, size_t begin, size_t end) {
+  // Each line is "TYPE;output;input1;input2;..."
+  std::vector<Factor> factors;
+  const char *str = text.c_str();
+  size_t pos = begin;
+
+  while (pos < end) {
+    size_t line_end = text.find('\n', pos);
+    if (line_end == std::string::npos || line_end > end) line_end = end;
+    const size_t next_line = line_end + 1;
+    if (line_end > pos && str[line_end - 1] == '\r') --line_end;
+    const size_t type_end = std::min(text.find(';', pos), line_end);
+
+    if (type_end < line_end) {
+      const std::string factor_type = text.substr(pos, type_end - pos);
+      std::vector<size_t> fields;
+      bool valid = true;
+
+      for (size_t field = type_end + 1; valid;) {
+        const size_t field_end = std::min(text.find(';', field), line_end);
+        // strtoull() would skip whitespace and signs, and stop at the first
+        // character which is not a digit, so check the field is only digits
+        char *digits_end = nullptr;
+        errno = 0;
+        fields.push_back(std::strtoull(str + field, &digits_end, 10));
+        valid = std::isdigit(static_cast<unsigned char>(str[field])) &&
+                digits_end == str + field_end && errno == 0;
+        if (field_end == line_end) break;
+        field = field_end + 1;
+      }
+
+      // The message kernels assume every factor has the edges of its type,
+      // and unknown gate types would be dead weight in the graph
+      const FactorType type = Factor::parseType(factor_type);
+      if (type == FactorType::UNSUPPORTED) {
+        spdlog::error("Skipping unsupported factor: {}", text.substr(pos, line_end - pos));
+        pos = next_line;
+        continue;
+      }
+      valid = valid && fields.size() == Factor::numRVs(type) &&
+              std::find(fields.begin() + 1, fields.end(), fields[0]) == fields.end();
+      if (!valid) {
+        spdlog::error("Skipping malformed factor: {}", text.substr(pos, line_end - pos));
+        pos = next_line;
+        continue;
+      }
+
+      const std::set<size_t> referenced_rvs(fields.begin(), fields.end());
+      Factor factor(factor_type, fields[0], referenced_rvs);
+
+      if (factor.type == FactorType::AND && referenced_rvs.size() < 3u) {
+        spdlog::warn("AND factor references the same RV twice as an input");
+        // a & a == a, so the factor behaves like a copy of its input
+        factor.type = FactorType::SAME;
+      }
+
+      factors.push_back(factor);
+    }
+
+    pos = next_line;
+  }
+
+  return factors;
 }
 
 bool Dataset::isHashInputBit(size_t bit_index) const {
@@ -101,59 +426,101 @@ bool Dataset::isHashInputBit(size_t bit_index) const {
 
 std::string Dataset::getHashInput(size_t sample_index) const {
   // Critical assumption here is that the input bits are at the beginning
-  const size_t n = config_->num_input_bits;
-  boost::dynamic_bitset<> input_bits(n);
-  for (size_t i = 0; i < n; ++i) {
-    input_bits[i] = samples_.at(sample_index)[i];
-  }
-  return utils::Convenience::bitset2hex(input_bits);
+  return utils::Convenience::bitset2hex(
+      getFullSample(sample_index).toBitset(config_->num_input_bits));
 }
 
 VariableAssignments Dataset::getObservedData(size_t sample_index) const {
   VariableAssignments observed;
+  const SampleView sample = getFullSample(sample_index);
 
   for (const size_t &bit_idx : config_->observed_rv_indices) {
-    const auto bitval = samples_.at(sample_index)[bit_idx];
-    observed[bit_idx] = bitval;
+    observed[bit_idx] = sample[bit_idx];
   }
 
   return observed;
 }
 
-bool Dataset::validate(const boost::dynamic_bitset<> predicted_input,
+VariableAssignments Dataset::getObservedData(const ColumnStore &columns, size_t first_sample,
+                                             size_t sample_index) const {
+  VariableAssignments observed;
+  for (const size_t &bit_idx : config_->observed_rv_indices) {
+    observed[bit_idx] = columns.value(bit_idx, sample_index - first_sample);
+  }
+  return observed;
+}
+
+bool Dataset::canValidate(const CircuitSimulator &simulator) const {
+  const Topology &graph = simulator.graph();
+  for (size_t v : simulator.inputs()) {
+    const size_t rv_index = graph.rvIndex(v);
+    if (!isHashInputBit(rv_index)) {
+      spdlog::error("RV {} has a PRIOR factor but is not a hash input bit", rv_index);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Dataset::validate(const CircuitSimulator &simulator,
+                       const boost::dynamic_bitset<> predicted_input,
                        size_t sample_index) const {
-  const std::string pred_in = utils::Convenience::bitset2hex(predicted_input);
-  const std::string true_in = getHashInput(sample_index);
-  std::ostringstream cmd;
-  cmd << "PYTHONPATH=.. python -m dataset_generation.generate";
-  cmd << " --num-input-bits " << predicted_input.size();
-  cmd << " --hash-algo " << config_->hash_algo;
-  cmd << " --difficulty " << config_->difficulty;
-  cmd << " --hash-input ";
-
-  const std::string pred_hash = utils::Convenience::exec(cmd.str() + pred_in);
-  const std::string true_hash = utils::Convenience::exec(cmd.str() + true_in);
+  PROFILE_SCOPE("validate");
+
+  // Evaluate the circuit on the predicted input, as the first of 64 lanes
+  const Topology &graph = simulator.graph();
+  const SampleView sample = getFullSample(sample_index);
+  std::vector<uint64_t> words(graph.numRVs(), 0);
+
+  // Only the predicted input is used, nothing of the sample besides its hash
+  for (size_t v : simulator.inputs()) {
+    const size_t rv_index = graph.rvIndex(v);
+    if (!isHashInputBit(rv_index) || rv_index >= predicted_input.size()) return false;
+    words[v] = predicted_input[rv_index];
+  }
+  simulator.evaluate(words.data(), 1);
+
+  // The predicted input is a pre-image if it reproduces every observed bit
+  // which the circuit computes
+  boost::dynamic_bitset<> pred_bits, true_bits;
+  for (size_t rv_index : config_->observed_rv_indices) {
+    const size_t v = graph.denseRV(rv_index);
+    if (v == Topology::npos) continue;
+    pred_bits.push_back(words[v] & 1);
+    true_bits.push_back(sample[rv_index]);
+  }
+
+  const std::string pred_hash = utils::Convenience::bitset2hex(pred_bits);
+  const std::string true_hash = utils::Convenience::bitset2hex(true_bits);
 
   if (pred_hash == true_hash) {
-    spdlog::info("\tHashes match: {}", pred_hash, true_hash);
+    spdlog::info("\tHashes match: {}", pred_hash);
     return true;
   }
 
   spdlog::info("\tHashes do not match!");
-  spdlog::info("\t\tTrue input      {}", true_in);
-  spdlog::info("\t\tPredicted input {}", pred_in);
+  spdlog::info("\t\tTrue input      {}", getHashInput(sample_index));
+  spdlog::info("\t\tPredicted input {}", utils::Convenience::bitset2hex(predicted_input));
   spdlog::info("\t\tPrediction gave {}", pred_hash);
   spdlog::info("\t\tCorrect hash is {}", true_hash);
   return false;
 }
 
-boost::dynamic_bitset<> Dataset::getFullSample(size_t sample_index) const {
+SampleView Dataset::getFullSample(size_t sample_index) const {
+  if (sample_index >= num_selected_) {
+    throw std::out_of_range("Sample index " + std::to_string(sample_index) + " out of range");
+  }
+
   const size_t n = config_->num_bits_per_sample;
-  boost::dynamic_bitset<> all_bits(n);
-  for (size_t i = 0; i < n; ++i) {
-    all_bits[i] = samples_.at(sample_index)[i];
+  if (config_->dataset_streaming) {
+    const Window window = getWindow(sample_index / window_samples_);
+    const size_t row = sample_index % window_samples_;
+    return SampleView(reinterpret_cast<const unsigned char *>(window->data()) + row * row_bytes_,
+                      n, window);
   }
-  return all_bits;
+
+  const size_t row = in_place_ ? sampleIndexInFile(sample_index) : sample_index;
+  return SampleView(samples_ + row * row_bytes_, n);
 }
 
 }  // end namespace hash_reversal
\ No newline at end of file
@@ -12,66 +12,38 @@
 
 #include "hash_reversal/factor.hpp"
 
-#include <spdlog/spdlog.h>
-
 namespace hash_reversal {
 
-/*****************************************
- *********** FACTOR GRAPH NODE ***********
- *****************************************/
-
-FactorGraphNode::~FactorGraphNode() {}
-
-void FactorGraphNode::updateMessage(size_t to, bool rv_val, double new_msg,
-                                    std::shared_ptr<utils::Config> config) {
-  const double damping = config->lbp_damping;
-
-  const std::pair<size_t, bool> key = {to, rv_val};
-  if (messages_.count(key) > 0) {
-    const double prev_msg = messages_.at(key);
-    messages_[key] = damping * new_msg + (1.0 - damping) * prev_msg;
-  } else {
-    messages_[key] = new_msg;
-  }
-}
-
-double FactorGraphNode::prevMessage(size_t to, bool rv_val) const {
-  const std::pair<size_t, bool> key = {to, rv_val};
-  if (messages_.count(key) > 0) return messages_.at(key);
-  return 1.0;
-}
-
-void FactorGraphNode::reset() {
-  messages_.clear();
-}
-
-/*****************************************
- ************ RANDOM VARIABLE ************
- *****************************************/
-
 /*****************************************
  **************** FACTOR *****************
  *****************************************/
 
-Factor::Factor() : factor_type("NULL") {}
+Factor::Factor() : factor_type("NULL"), type(FactorType::UNSUPPORTED) {}
 
 Factor::Factor(const std::string &ftype, size_t out, const std::set<size_t> &ref)
-    : factor_type(ftype), output_rv(out), referenced_rvs(ref) {}
+    : factor_type(ftype), type(parseType(ftype)), output_rv(out), referenced_rvs(ref) {}
+
+FactorType Factor::parseType(const std::string &ftype) {
+  if (ftype == "PRIOR") return FactorType::PRIOR;
+  if (ftype == "INV") return FactorType::INV;
+  if (ftype == "SAME") return FactorType::SAME;
+  if (ftype == "AND") return FactorType::AND;
+  return FactorType::UNSUPPORTED;
+}
 
-Factor::Values Factor::extract(const VariableAssignments &assignments) const {
-  Values v;
-  bool did_set_in1 = false;
-  for (size_t rv_index : referenced_rvs) {
-    if (rv_index == output_rv) {
-      v.out = assignments.at(rv_index);
-    } else if (!did_set_in1) {
-      v.in1 = assignments.at(rv_index);
-      did_set_in1 = true;
-    } else {
-      v.in2 = assignments.at(rv_index);
-    }
+size_t Factor::numRVs(FactorType type) {
+  switch (type) {
+    case FactorType::PRIOR:
+      return 1;
+    case FactorType::INV:
+    case FactorType::SAME:
+      return 2;
+    case FactorType::AND:
+      return 3;
+    case FactorType::UNSUPPORTED:
+      break;
   }
-  return v;
+  return 0;
 }
 
 std::vector<size_t> Factor::inputRVs() const {
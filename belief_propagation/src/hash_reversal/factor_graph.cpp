@@ -15,24 +15,41 @@
 #include <spdlog/spdlog.h>
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <limits>
 #include <string>
 
+#include "utils/memory.hpp"
+#include "utils/profiler.hpp"
+
 namespace hash_reversal {
 
 FactorGraph::FactorGraph(std::shared_ptr<Probability> prob,
                          std::shared_ptr<Dataset> dataset,
-                         std::shared_ptr<utils::Config> config)
-    : InferenceTool(prob, dataset, config) {}
+                         std::shared_ptr<utils::Config> config,
+                         std::shared_ptr<const Topology> graph)
+    : InferenceTool(prob, dataset, config, graph),
+      max_delta_(0.0),
+      first_sweep_(true),
+      measured_speedup_(false),
+      iterations_(0) {
+  const std::string &schedule = config_->lbp_schedule;
+  if (schedule == "flooding" || schedule == "wavefront") {
+    pool_ = std::unique_ptr<utils::ThreadPool>(new utils::ThreadPool(config_->num_threads));
+  }
+}
 
-InferenceTool::Prediction FactorGraph::predict(size_t rv_index) const {
+InferenceTool::Prediction FactorGraph::predict(size_t v) const {
+  const size_t rv_index = core_->rvIndex(v);
   InferenceTool::Prediction prediction(rv_index, 0.5);
   double msg0 = 1.0, msg1 = 1.0;
-  const auto &rv = rvs_.at(rv_index);
+  const auto &rv_edges = core_->rvEdges();
 
-  for (size_t factor_index : rv.factor_indices) {
-    msg0 *= factors_.at(factor_index).prevMessage(rv_index, 0);
-    msg1 *= factors_.at(factor_index).prevMessage(rv_index, 1);
+  for (size_t i = core_->rvBegin(v); i < core_->rvEnd(v); ++i) {
+    const Message &msg = factor_msgs_[rv_edges[i]];
+    msg0 *= msg[0];
+    msg1 *= msg[1];
   }
 
   if (msg0 + msg1 == 0) {
@@ -46,138 +63,443 @@ InferenceTool::Prediction FactorGraph::predict(size_t rv_index) const {
 
 std::vector<InferenceTool::Prediction> FactorGraph::marginals() const {
   std::vector<InferenceTool::Prediction> predictions;
-  predictions.reserve(factors_.size());
-  for (auto &itr : factors_) predictions.push_back(predict(itr.first));
+  predictions.reserve(graph_->numFactors());
+  for (size_t f = 0; f < graph_->numFactors(); ++f) {
+    const size_t v = graph_->factorOutput(f);
+    const Observation obs = rv_obs_[v];
+    if (config_->lbp_compaction && obs != UNOBSERVED) {
+      // Observed RVs are not solved for at all in a compacted graph
+      predictions.emplace_back(graph_->rvIndex(v), obs == OBSERVED_ONE ? 1.0 : 0.0);
+    } else {
+      predictions.push_back(predict(core_->denseRV(graph_->rvIndex(v))));
+    }
+  }
   return predictions;
 }
 
+size_t FactorGraph::memoryBytes() const {
+  using utils::Memory;
+  size_t bytes = InferenceTool::memoryBytes() + Memory::bytes(core_obs_) +
+                 Memory::bytes(core_factors_) + Memory::bytes(factor_msgs_) + Memory::bytes(rv_msgs_) +
+                 Memory::bytes(next_factor_msgs_) + Memory::bytes(next_rv_msgs_) +
+                 Memory::bytes(candidate_msgs_) + Memory::bytes(residuals_) +
+                 residual_queue_.memoryBytes();
+  if (core_ && core_ != graph_) bytes += core_->memoryBytes();
+  return bytes;
+}
+
 void FactorGraph::reconfigure(const VariableAssignments &observed) {
-  observed_ = observed;
-  previous_marginals_.clear();
-  for (auto &itr : rvs_) itr.second.reset();
-  for (auto &itr : factors_) itr.second.reset();
+  setObserved(observed);
+  if (config_->lbp_compaction) {
+    compact();
+  } else {
+    core_ = graph_;
+    core_obs_ = rv_obs_;
+  }
+
+  factor_msgs_.assign(core_->numEdges(), {1.0, 1.0});
+  rv_msgs_.assign(core_->numEdges(), {1.0, 1.0});
+  if (pool_) {
+    next_factor_msgs_ = factor_msgs_;
+    next_rv_msgs_ = rv_msgs_;
+  }
+  first_sweep_ = true;
+}
+
+void FactorGraph::compact() {
+  // A factor whose RVs are all observed only sends messages to observed RVs,
+  // so it cannot change the marginal of any unknown RV and is left out
+  core_factors_.assign(graph_->numFactors(), 0);
+  for (size_t f = 0; f < graph_->numFactors(); ++f) {
+    for (size_t e = graph_->factorBegin(f); e < graph_->factorEnd(f); ++e) {
+      if (rv_obs_[graph_->edgeRV(e)] == UNOBSERVED) {
+        core_factors_[f] = 1;
+        break;
+      }
+    }
+  }
+
+  // The remaining observed RVs border the core and are treated as evidence
+  core_ = std::make_shared<const Topology>(*graph_, core_factors_);
+  core_obs_.resize(core_->numRVs());
+  for (size_t v = 0; v < core_->numRVs(); ++v) {
+    core_obs_[v] = rv_obs_[graph_->denseRV(core_->rvIndex(v))];
+  }
+
+  spdlog::info("\tCompacted the graph to {}/{} RVs and {}/{} factors", core_->numRVs(),
+               graph_->numRVs(), core_->numFactors(), graph_->numFactors());
+}
+
+double FactorGraph::updateMessage(const Message &prev, Message &next, double msg0,
+                                  double msg1) const {
+  // Messages are only defined up to scale, so they are normalized to keep the
+  // products around loops from underflowing. A message which is all zeros or
+  // not finite has no direction: the previous one is kept, and the change is
+  // infinite so that the iteration cannot pass for converged.
+  const double sum = msg0 + msg1;
+  if (!(sum > 0.0) || !std::isfinite(sum)) {
+    next = prev;
+    return std::numeric_limits<double>::infinity();
+  }
+  msg0 /= sum;
+  msg1 /= sum;
+
+  const double prev_sum = prev[0] + prev[1];
+  const double prev_p = prev[1] / prev_sum;
+  if (first_sweep_) {
+    next = {msg0, msg1};
+  } else {
+    const double damping = config_->lbp_damping;
+    next = {damping * msg0 + (1.0 - damping) * prev[0] / prev_sum,
+            damping * msg1 + (1.0 - damping) * prev[1] / prev_sum};
+  }
+  return std::abs(next[1] - prev_p);
+}
+
+void FactorGraph::trackDelta(double delta) {
+  double current = max_delta_.load();
+  while (delta > current && !max_delta_.compare_exchange_weak(current, delta)) {
+  }
 }
 
 void FactorGraph::solve() {
+  PROFILE_SCOPE("solve");
   spdlog::info("\tStarting loopy BP...");
-  const auto start = utils::Convenience::time_since_epoch();
+  const auto start = std::chrono::steady_clock::now();
+
+  if (config_->lbp_schedule == "residual") {
+    residualSchedule();
+    spdlog::info("\tLBP finished in {:.3f} seconds.", utils::Convenience::seconds_since(start));
+    return;
+  }
 
+  // Convergence is decided from the largest message change seen during the
+  // updates themselves, the marginals are only computed when asked for.
   size_t itr = 0, forward = 0;
+  bool invalid = false;
   for (itr = 0; itr < config_->lbp_max_iter; ++itr) {
-    updateRandomVariableMessages(forward);
-    updateFactorMessages(forward);
-    const auto marg = marginals();
-    if (equal(previous_marginals_, marg)) break;
-    previous_marginals_ = marg;
+    PROFILE_SCOPE("lbp_iteration");
+    double delta = 0.0;
+    if (config_->lbp_schedule == "flooding") {
+      delta = floodingIteration();
+    } else if (config_->lbp_schedule == "wavefront") {
+      delta = wavefrontIteration();
+    } else {
+      delta = updateRandomVariableMessages(forward);
+      delta = std::max(delta, updateFactorMessages(forward));
+    }
+    first_sweep_ = false;
+    PROFILE_COUNT("messages_updated", 2 * core_->numEdges());
+    PROFILE_VALUE("lbp_residual", delta);
+    // When flooding, the RV messages of the first iteration are built from the
+    // initial factor messages, so the second iteration repeats the first one.
+    const bool can_converge = config_->lbp_schedule != "flooding" || itr > 1;
+    if (std::isinf(delta)) invalid = true;
+    if (can_converge && delta <= convergence_tol) break;
     forward = (forward + 1) % 2;
   }
 
+  iterations_ = std::min<size_t>(itr + 1, config_->lbp_max_iter);
+  PROFILE_VALUE("lbp_iterations", iterations_);
+  if (invalid) spdlog::warn("\tSome messages were all zeros or not finite and were not updated.");
   if (itr >= config_->lbp_max_iter) {
     spdlog::warn("\tLoopy BP did not converge, max iterations reached.");
   } else {
     spdlog::info("\tLoopy BP converged in {} iterations", itr + 1);
   }
 
-  const auto end = utils::Convenience::time_since_epoch();
-  spdlog::info("\tLBP finished in {} seconds.", end - start);
+  spdlog::info("\tLBP finished in {:.3f} seconds.", utils::Convenience::seconds_since(start));
 }
 
-bool FactorGraph::equal(const std::vector<InferenceTool::Prediction> &marginals1,
-                        const std::vector<InferenceTool::Prediction> &marginals2,
-                        double tol) const {
-  const size_t n = marginals1.size();
-  if (n != marginals2.size()) return false;
+size_t FactorGraph::computeFactor(size_t f, const Message *rv_msgs, Message *out) const {
+  const FactorType type = core_->factorType(f);
+  if (type == FactorType::UNSUPPORTED) return 0;
 
+  const size_t begin = core_->factorBegin(f);
+  const size_t n = core_->factorEnd(f) - begin;
+  Message in[Factor::kMaxRVs] = {};
+
+  // Observed RVs only contribute their message for the observed value, or
+  // are constant evidence when the graph has been compacted
   for (size_t i = 0; i < n; ++i) {
-    const size_t rv1 = marginals1.at(i).rv_index;
-    const size_t rv2 = marginals2.at(i).rv_index;
-    if (rv1 != rv2) return false;
-    const double p1 = marginals1.at(i).prob_one;
-    const double p2 = marginals2.at(i).prob_one;
-    if (std::abs(p1 - p2) > tol) return false;
+    const Message &msg = rv_msgs[begin + i];
+    const Observation obs = core_obs_[core_->edgeRV(begin + i)];
+    if (obs != UNOBSERVED && config_->lbp_compaction) {
+      in[i] = {obs == OBSERVED_ZERO ? 1.0 : 0.0, obs == OBSERVED_ONE ? 1.0 : 0.0};
+    } else {
+      in[i] = {obs == OBSERVED_ONE ? 0.0 : msg[0], obs == OBSERVED_ZERO ? 0.0 : msg[1]};
+    }
   }
 
-  return true;
+  prob_->factorMessages(type, core_obs_[core_->factorOutput(f)], in, out);
+  return n;
+}
+
+double FactorGraph::updateFactor(size_t f, const Message *rv_msgs, const Message *prev,
+                                 Message *next) const {
+  Message out[Factor::kMaxRVs] = {};
+  const size_t begin = core_->factorBegin(f);
+  const size_t n = computeFactor(f, rv_msgs, out);
+  double max_delta = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    const double delta = updateMessage(prev[begin + i], next[begin + i], out[i][0], out[i][1]);
+    if (delta > max_delta) max_delta = delta;
+  }
+  return max_delta;
 }
 
-void FactorGraph::updateFactorMessages(bool forward) {
-  auto fwd_itr = factors_.begin();
-  auto rev_itr = factors_.rbegin();
+double FactorGraph::updateRandomVariable(size_t v, const Message *factor_msgs,
+                                         const Message *prev, Message *next) const {
+  const auto &rv_edges = core_->rvEdges();
+  const size_t begin = core_->rvBegin(v);
+  const size_t end = core_->rvEnd(v);
+  bool invalid = false;
 
-  for (size_t idx = 0; idx < factors_.size(); ++idx) {
-    auto &factor = forward ? fwd_itr->second : rev_itr->second;
-    const size_t factor_index = forward ? fwd_itr->first : rev_itr->first;
-    if (forward) {
-      ++fwd_itr;
+  for (size_t i = begin; i < end; ++i) {
+    double result0 = 1.0;
+    double result1 = 1.0;
+    for (size_t j = begin; j < end; ++j) {
+      if (i == j) continue;
+      result0 *= factor_msgs[rv_edges[j]][0];
+      result1 *= factor_msgs[rv_edges[j]][1];
+    }
+    const size_t e = rv_edges[i];
+    // Only invalid RV -> factor messages count, convergence is decided from
+    // the factor -> RV messages
+    if (std::isinf(updateMessage(prev[e], next[e], result0, result1))) invalid = true;
+  }
+  return invalid ? std::numeric_limits<double>::infinity() : 0.0;
+}
+
+double FactorGraph::updateFactorMessages(bool forward) {
+  const size_t num_factors = core_->numFactors();
+  double max_delta = 0.0;
+  for (size_t idx = 0; idx < num_factors; ++idx) {
+    const size_t f = forward ? idx : num_factors - idx - 1;
+    const double delta =
+        updateFactor(f, rv_msgs_.data(), factor_msgs_.data(), factor_msgs_.data());
+    if (delta > max_delta) max_delta = delta;
+  }
+  return max_delta;
+}
+
+double FactorGraph::updateRandomVariableMessages(bool forward) {
+  const size_t num_rvs = core_->numRVs();
+  double max_delta = 0.0;
+  for (size_t idx = 0; idx < num_rvs; ++idx) {
+    const size_t v = forward ? idx : num_rvs - idx - 1;
+    max_delta = std::max(
+        max_delta, updateRandomVariable(v, factor_msgs_.data(), rv_msgs_.data(), rv_msgs_.data()));
+  }
+  return max_delta;
+}
+
+void FactorGraph::floodingRange(size_t begin, size_t end) {
+  // Nodes [0, num_factors) are factors and the remaining ones are RVs
+  const size_t num_factors = core_->numFactors();
+  double max_delta = 0.0;
+  for (size_t node = begin; node < end; ++node) {
+    if (node < num_factors) {
+      const double delta =
+          updateFactor(node, rv_msgs_.data(), factor_msgs_.data(), next_factor_msgs_.data());
+      if (delta > max_delta) max_delta = delta;
     } else {
-      ++rev_itr;
+      const double delta = updateRandomVariable(node - num_factors, factor_msgs_.data(),
+                                                rv_msgs_.data(), next_rv_msgs_.data());
+      if (delta > max_delta) max_delta = delta;
     }
+  }
+  trackDelta(max_delta);
+}
 
-    for (size_t to_rv : factor.referenced_rvs) {
-      std::set<size_t> unobserved_indices;
-      for (size_t rv_index : factor.referenced_rvs) {
-        if (observed_.count(rv_index) == 0 && rv_index != to_rv) {
-          unobserved_indices.insert(rv_index);
-        }
-      }
+double FactorGraph::floodingIteration() {
+  // Every message of the next iteration only depends on messages of the
+  // current one, so all nodes can be updated concurrently without locks.
+  const size_t num_nodes = core_->numFactors() + core_->numRVs();
+  const auto task = [this](size_t begin, size_t end) { floodingRange(begin, end); };
+  max_delta_ = 0.0;
 
-      VariableAssignments assignments = observed_;
-      const size_t n = unobserved_indices.size();
-      const size_t num_combinations = 1 << n;
-      double result0 = 0, result1 = 0;
+  if (!measured_speedup_) {
+    // Recomputing the same iteration is harmless since it writes the same
+    // values, so warm up the caches once and then time both variants.
+    pool_->parallelFor(num_nodes, task);
+    const auto t0 = std::chrono::steady_clock::now();
+    floodingRange(0, num_nodes);
+    const auto t1 = std::chrono::steady_clock::now();
+    pool_->parallelFor(num_nodes, task);
+    const auto t2 = std::chrono::steady_clock::now();
 
-      for (size_t combo = 0; combo < num_combinations; ++combo) {
-        size_t i = 0;
-        for (size_t unobserved_rv_index : unobserved_indices) {
-          assignments[unobserved_rv_index] = (combo >> (i++)) & 1;
-        }
+    const double serial = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    const double parallel = std::chrono::duration<double, std::milli>(t2 - t1).count();
+    spdlog::info("\tFlooding iteration: {:.3f} ms serial, {:.3f} ms with {} threads ({:.2f}x)",
+                 serial, parallel, pool_->size(), serial / std::max(parallel, 1e-9));
+    measured_speedup_ = true;
+  } else {
+    pool_->parallelFor(num_nodes, task);
+  }
 
-        assignments[to_rv] = false;
-        double message_product0 = prob_->probOne(factor, assignments, observed_);
-        assignments[to_rv] = true;
-        double message_product1 = prob_->probOne(factor, assignments, observed_);
+  factor_msgs_.swap(next_factor_msgs_);
+  rv_msgs_.swap(next_rv_msgs_);
+  return max_delta_;
+}
 
-        for (size_t rv_index : factor.referenced_rvs) {
-          if (rv_index == to_rv) continue;
-          const bool rv_val = assignments[rv_index];
-          message_product0 *= rvs_.at(rv_index).prevMessage(factor_index, rv_val);
-          message_product1 *= rvs_.at(rv_index).prevMessage(factor_index, rv_val);
+void FactorGraph::wavefrontLevel(size_t level) {
+  const auto &level_factors = core_->levelFactors();
+  const auto &rv_edges = core_->rvEdges();
+  const size_t offset = core_->levelBegin(level);
+  const size_t num_factors = core_->levelEnd(level) - offset;
+
+  // First refresh the RV -> factor messages into this level's factors ...
+  pool_->parallelFor(num_factors, [&](size_t begin, size_t end) {
+    for (size_t idx = begin; idx < end; ++idx) {
+      const size_t f = level_factors[offset + idx];
+      for (size_t e = core_->factorBegin(f); e < core_->factorEnd(f); ++e) {
+        const size_t v = core_->edgeRV(e);
+        double result0 = 1.0, result1 = 1.0;
+        for (size_t i = core_->rvBegin(v); i < core_->rvEnd(v); ++i) {
+          if (rv_edges[i] == e) continue;
+          result0 *= factor_msgs_[rv_edges[i]][0];
+          result1 *= factor_msgs_[rv_edges[i]][1];
         }
-        result0 += message_product0;
-        result1 += message_product1;
+        updateMessage(rv_msgs_[e], rv_msgs_[e], result0, result1);
       }
+    }
+  });
 
-      factor.updateMessage(to_rv, 0, result0, config_);
-      factor.updateMessage(to_rv, 1, result1, config_);
+  // ... then the factor -> RV messages out of them
+  pool_->parallelFor(num_factors, [&](size_t begin, size_t end) {
+    double max_delta = 0.0;
+    for (size_t idx = begin; idx < end; ++idx) {
+      const size_t f = level_factors[offset + idx];
+      const double delta =
+          updateFactor(f, rv_msgs_.data(), factor_msgs_.data(), factor_msgs_.data());
+      if (delta > max_delta) max_delta = delta;
     }
-  }
+    trackDelta(max_delta);
+  });
+}
+
+double FactorGraph::wavefrontIteration() {
+  // Sweep the circuit from the PRIOR inputs to the hash output and back again,
+  // so evidence crosses the whole circuit in one iteration. Every edge is
+  // owned by one factor, so the factors of a level update their own edges in
+  // parallel. They can still share RVs, which is why all RV -> factor messages
+  // of a level are refreshed before any of its factor -> RV messages change.
+  const size_t num_levels = core_->numLevels();
+  max_delta_ = 0.0;
+  for (size_t level = 0; level < num_levels; ++level) wavefrontLevel(level);
+  first_sweep_ = false;
+  for (size_t level = num_levels; level-- > 0;) wavefrontLevel(level);
+  return max_delta_;
 }
 
-void FactorGraph::updateRandomVariableMessages(bool forward) {
-  auto fwd_itr = rvs_.begin();
-  auto rev_itr = rvs_.rbegin();
+bool FactorGraph::updateResiduals(size_t f) {
+  const size_t begin = core_->factorBegin(f);
+  const size_t n = computeFactor(f, rv_msgs_.data(), &candidate_msgs_[begin]);
+  bool valid = true;
 
-  for (size_t idx = 0; idx < rvs_.size(); ++idx) {
-    auto &rv = forward ? fwd_itr->second : rev_itr->second;
-    const size_t rv_index = forward ? fwd_itr->first : rev_itr->first;
-    if (forward) {
-      ++fwd_itr;
+  for (size_t e = begin; e < begin + n; ++e) {
+    // Pending messages are normalized so that repeated updates around loops
+    // cannot drive them to zero, which keeps P(RV = 1) of each message intact.
+    // One which is all zeros or not finite is never committed.
+    Message &cand = candidate_msgs_[e];
+    const double norm = cand[0] + cand[1];
+    double residual = 0.0;
+    if (norm > 0 && std::isfinite(norm)) {
+      cand = {cand[0] / norm, cand[1] / norm};
+      const Message &curr = factor_msgs_[e];
+      residual = std::abs(cand[1] - curr[1] / (curr[0] + curr[1]));
     } else {
-      ++rev_itr;
+      valid = false;
     }
 
-    for (size_t fac_idx : rv.factor_indices) {
-      double result0 = 1.0;
-      double result1 = 1.0;
-      for (size_t other_fac_idx : rv.factor_indices) {
-        if (fac_idx == other_fac_idx) continue;
-        result0 *= factors_.at(other_fac_idx).prevMessage(rv_index, 0);
-        result1 *= factors_.at(other_fac_idx).prevMessage(rv_index, 1);
+    if (residual != residuals_[e]) {
+      residuals_[e] = residual;
+      if (residual >= convergence_tol) {
+        residual_queue_.set(e, residual);
+      } else {
+        residual_queue_.erase(e);
       }
-      rv.updateMessage(fac_idx, 0, result0, config_);
-      rv.updateMessage(fac_idx, 1, result1, config_);
     }
   }
+  return valid;
+}
+
+void FactorGraph::residualSchedule() {
+  // Residual BP: always commit the pending factor -> RV message which differs
+  // the most from the current one, then refresh the pending messages of the
+  // factors which read the RV -> factor messages that changed as a result.
+  // Messages are committed undamped, the ordering already keeps the updates
+  // from oscillating the way a flooding schedule can.
+  // The budget is the number of factor evaluations of `lbp_max_iter` serial
+  // iterations. Every commit re-evaluates the other factors of its RV, so
+  // bounding the commits instead would let a sample which does not converge
+  // cost several times as much as with the serial schedule.
+  const size_t num_edges = core_->numEdges();
+  const size_t max_evaluations = config_->lbp_max_iter * core_->numFactors();
+  const auto &rv_edges = core_->rvEdges();
+
+  candidate_msgs_.assign(num_edges, {1.0, 1.0});
+  residuals_.assign(num_edges, 0.0);
+  residual_queue_.reset(num_edges);
+
+  bool valid = !std::isinf(updateRandomVariableMessages(true));
+  first_sweep_ = false;
+  for (size_t f = 0; f < core_->numFactors(); ++f) valid &= updateResiduals(f);
+
+  size_t num_updates = 0, num_evaluations = core_->numFactors();
+  while (!residual_queue_.empty() && num_evaluations < max_evaluations) {
+    const size_t e = residual_queue_.top();
+    residual_queue_.pop();
+
+    factor_msgs_[e] = candidate_msgs_[e];
+    residuals_[e] = 0.0;
+    ++num_updates;
+
+    // The messages into the committed edge's factor are unchanged, so only
+    // the factors which share its RV get new pending messages
+    const size_t f = core_->edgeFactor(e);
+    const size_t v = core_->edgeRV(e);
+
+    const size_t begin = core_->rvBegin(v);
+    const size_t end = core_->rvEnd(v);
+    for (size_t i = begin; i < end; ++i) {
+      const size_t to_edge = rv_edges[i];
+      if (to_edge == e) continue;
+      double result0 = 1.0, result1 = 1.0;
+      for (size_t j = begin; j < end; ++j) {
+        if (i == j) continue;
+        result0 *= factor_msgs_[rv_edges[j]][0];
+        result1 *= factor_msgs_[rv_edges[j]][1];
+      }
+      const double sum = result0 + result1;
+      if (sum > 0 && std::isfinite(sum)) {
+        rv_msgs_[to_edge] = {result0 / sum, result1 / sum};
+      } else {
+        valid = false;
+      }
+    }
+    for (size_t i = begin; i < end; ++i) {
+      const size_t g = core_->edgeFactor(rv_edges[i]);
+      if (g == f) continue;
+      valid &= updateResiduals(g);
+      ++num_evaluations;
+    }
+  }
+
+  const double sweeps = num_updates / double(std::max<size_t>(1, num_edges));
+  iterations_ = static_cast<size_t>(std::ceil(sweeps));
+  PROFILE_COUNT("messages_updated", num_updates);
+  PROFILE_VALUE("residual_sweeps", sweeps);
+  if (!valid) spdlog::warn("\tSome messages were all zeros or not finite and were not updated.");
+  if (!residual_queue_.empty()) {
+    spdlog::warn("\tResidual BP did not converge, max factor evaluations reached.");
+  } else if (!valid) {
+    spdlog::warn("\tResidual BP did not converge, some messages were invalid.");
+  } else {
+    spdlog::info("\tResidual BP converged after {} message updates ({:.2f} sweeps)",
+                 num_updates, sweeps);
+  }
 }
 
 }  // end namespace hash_reversal
\ No newline at end of file
@@ -12,66 +12,109 @@
 
 #include "hash_reversal/inference_tool.hpp"
 
-#include <list>
+#include <chrono>
+#include <set>
 
 #include <spdlog/spdlog.h>
 
+#include "utils/memory.hpp"
+#include "utils/profiler.hpp"
+
 namespace hash_reversal {
 
 InferenceTool::InferenceTool(std::shared_ptr<Probability> prob,
                              std::shared_ptr<Dataset> dataset,
-                             std::shared_ptr<utils::Config> config)
-    : prob_(prob), dataset_(dataset), config_(config) {
+                             std::shared_ptr<utils::Config> config,
+                             std::shared_ptr<const Topology> graph)
+    : prob_(prob), dataset_(dataset), config_(config), graph_(graph) {}
+
+std::shared_ptr<const Topology> InferenceTool::loadGraph(const Dataset &dataset,
+                                                         const utils::Config &config) {
+  PROFILE_SCOPE("graph");
   spdlog::info("Loading factors and random variables...");
-  const auto start = utils::Convenience::time_since_epoch();
+  const auto start = std::chrono::steady_clock::now();
 
-  const auto graph = dataset_->loadFactorGraph();
-  rvs_ = graph.first;
-  factors_ = graph.second;
-  spdlog::info("\tCreated {} RVs and {} factors.", rvs_.size(), factors_.size());
+  const auto graph = std::make_shared<const Topology>(dataset.loadFactorGraph());
+  spdlog::info("\tCreated {} RVs and {} factors.", graph->numRVs(), graph->numFactors());
+  spdlog::info("\tThe circuit has {} topological levels.", graph->numLevels());
 
-  const auto end = utils::Convenience::time_since_epoch();
-  spdlog::info("Finished initializing factor graph in {} seconds.", end - start);
+  spdlog::info("Finished initializing factor graph in {:.3f} seconds.",
+               utils::Convenience::seconds_since(start));
 
-  if (config_->print_connections) printConnections();
+  if (config.print_connections) printConnections(*graph);
+  return graph;
 }
 
 InferenceTool::~InferenceTool() {}
 
-VariableAssignments InferenceTool::propagateObserved(const VariableAssignments &observed) const {
-  // TODO: Propagate backward --> forward --> backward ... until nothing new observed
-  VariableAssignments fully_obs = observed;
-  std::list<size_t> queue;
-  std::set<size_t> seen;
-  for (auto &itr : observed) queue.push_back(itr.first);
-
-  while (queue.size() > 0) {
-    const size_t rv = queue.front();
-    queue.pop_front();
-    seen.insert(rv);
-
-    const bool rv_val = fully_obs.at(rv);
-    const Factor &factor = factors_.at(rv);
-    const std::string &f_type = factor.factor_type;
-    const auto inputs = factor.inputRVs();
-
-    if (f_type == "INV") {
-      const size_t parent = inputs.at(0);
-      fully_obs[parent] = !rv_val;
-      if (seen.count(parent) == 0) queue.push_back(parent);
-    } else if (f_type == "SAME") {
-      const size_t parent = inputs.at(0);
-      fully_obs[parent] = rv_val;
-      if (seen.count(parent) == 0) queue.push_back(parent);
-    } else if (f_type == "AND" && rv_val == true) {
-      const size_t inp1 = inputs.at(0);
-      const size_t inp2 = inputs.at(1);
-      fully_obs[inp1] = true;
-      fully_obs[inp2] = true;
-      if (seen.count(inp1) == 0) queue.push_back(inp1);
-      if (seen.count(inp2) == 0) queue.push_back(inp2);
+VariableAssignments InferenceTool::propagateObserved(const VariableAssignments &observed,
+                                                     size_t *num_conflicts_out) const {
+  PROFILE_SCOPE("propagate");
+
+  // Unit propagation to a fixpoint: whenever an RV becomes known, every factor
+  // it belongs to is checked for values it now implies, forward and backward
+  const size_t num_rvs = graph_->numRVs();
+  std::vector<Observation> values(num_rvs, UNOBSERVED);
+  std::vector<size_t> queue;
+  queue.reserve(num_rvs);
+  size_t num_conflicts = 0;
+
+  const auto assign = [&](size_t v, bool val) {
+    const Observation obs = val ? OBSERVED_ONE : OBSERVED_ZERO;
+    if (values[v] == UNOBSERVED) {
+      values[v] = obs;
+      queue.push_back(v);
+    } else if (values[v] != obs) {
+      ++num_conflicts;
     }
+  };
+
+  for (auto &itr : observed) {
+    const size_t v = graph_->denseRV(itr.first);
+    if (v != Topology::npos) assign(v, itr.second);
+  }
+
+  const auto &rv_edges = graph_->rvEdges();
+  for (size_t idx = 0; idx < queue.size(); ++idx) {
+    const size_t v = queue[idx];
+    for (size_t i = graph_->rvBegin(v); i < graph_->rvEnd(v); ++i) {
+      const size_t f = graph_->edgeFactor(rv_edges[i]);
+      const size_t begin = graph_->factorBegin(f);
+      const size_t out = graph_->edgeRV(begin);
+      const FactorType f_type = graph_->factorType(f);
+
+      if (f_type == FactorType::INV || f_type == FactorType::SAME) {
+        const size_t inp = graph_->edgeRV(begin + 1);
+        const bool flip = f_type == FactorType::INV;
+        if (values[out] != UNOBSERVED) assign(inp, (values[out] == OBSERVED_ONE) != flip);
+        if (values[inp] != UNOBSERVED) assign(out, (values[inp] == OBSERVED_ONE) != flip);
+      } else if (f_type == FactorType::AND) {
+        const size_t inp1 = graph_->edgeRV(begin + 1);
+        const size_t inp2 = graph_->edgeRV(begin + 2);
+        const Observation out_val = values[out];
+        const Observation val1 = values[inp1], val2 = values[inp2];
+        // Forward: a zero input forces a zero output, two one inputs a one
+        if (val1 == OBSERVED_ZERO || val2 == OBSERVED_ZERO) assign(out, false);
+        if (val1 == OBSERVED_ONE && val2 == OBSERVED_ONE) assign(out, true);
+        // Backward: a one output forces both inputs, a zero output with one
+        // input known to be one forces the other input to zero
+        if (out_val == OBSERVED_ONE) {
+          assign(inp1, true);
+          assign(inp2, true);
+        }
+        if (out_val == OBSERVED_ZERO && val1 == OBSERVED_ONE) assign(inp2, false);
+        if (out_val == OBSERVED_ZERO && val2 == OBSERVED_ONE) assign(inp1, false);
+      }
+    }
+  }
+
+  if (num_conflicts > 0) {
+    spdlog::warn("\tObserved values contradict the circuit in {} places", num_conflicts);
   }
+  if (num_conflicts_out) *num_conflicts_out = num_conflicts;
+
+  VariableAssignments fully_obs = observed;
+  for (size_t v : queue) fully_obs[graph_->rvIndex(v)] = values[v] == OBSERVED_ONE;
 
   const size_t diff = fully_obs.size() - observed.size();
   spdlog::info("\tAble to solve {} additional RV values", diff);
@@ -92,21 +135,39 @@ std::vector<InferenceTool::Prediction> InferenceTool::marginals() const {
   return {};
 }
 
+size_t InferenceTool::memoryBytes() const {
+  return utils::Memory::bytes(observed_) + utils::Memory::bytes(rv_obs_);
+}
+
+void InferenceTool::setObserved(const VariableAssignments &observed) {
+  observed_ = observed;
+  rv_obs_.assign(graph_->numRVs(), UNOBSERVED);
+  for (auto &itr : observed_) {
+    const size_t v = graph_->denseRV(itr.first);
+    if (v != Topology::npos) rv_obs_[v] = itr.second ? OBSERVED_ONE : OBSERVED_ZERO;
+  }
+}
+
 std::map<size_t, std::string> InferenceTool::factorTypes() const {
   std::map<size_t, std::string> f_types;
-  for (auto &itr : factors_) {
-    f_types[itr.first] = itr.second.factor_type;
+  for (size_t f = 0; f < graph_->numFactors(); ++f) {
+    f_types[graph_->rvIndex(graph_->factorOutput(f))] = graph_->factorName(f);
   }
   return f_types;
 }
 
-void InferenceTool::printConnections() const {
-  for (auto &itr : factors_) {
-    const size_t rv = itr.first;
-    const auto &rv_neighbors = rvs_.at(rv).factor_indices;
+void InferenceTool::printConnections(const Topology &graph) {
+  const auto &rv_edges = graph.rvEdges();
+  for (size_t f = 0; f < graph.numFactors(); ++f) {
+    const size_t v = graph.factorOutput(f);
+    const size_t rv = graph.rvIndex(v);
+    std::set<size_t> rv_neighbors;
+    for (size_t i = graph.rvBegin(v); i < graph.rvEnd(v); ++i) {
+      rv_neighbors.insert(graph.factor(graph.edgeFactor(rv_edges[i])).output_rv);
+    }
     const std::string rv_nb_str = utils::Convenience::set2str<size_t>(rv_neighbors);
     spdlog::info("\tRV {} is referenced by factors {}", rv, rv_nb_str);
-    const auto &fac_neighbors = itr.second.referenced_rvs;
+    const auto &fac_neighbors = graph.factor(f).referenced_rvs;
     const std::string fac_nb_str = utils::Convenience::set2str<size_t>(fac_neighbors);
     spdlog::info("\tFactor: RV {} depends on RVs {}", rv, fac_nb_str);
   }
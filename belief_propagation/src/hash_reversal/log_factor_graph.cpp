@@ -0,0 +1,263 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "hash_reversal/log_factor_graph.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#include "utils/memory.hpp"
+#include "utils/profiler.hpp"
+
+namespace hash_reversal {
+
+template <typename T>
+LogFactorGraph<T>::LogFactorGraph(std::shared_ptr<Probability> prob,
+                                  std::shared_ptr<Dataset> dataset,
+                                  std::shared_ptr<utils::Config> config,
+                                  std::shared_ptr<const Topology> graph)
+    : InferenceTool(prob, dataset, config, graph),
+      step_(1.0),
+      tolerance_(convergence_tol),
+      num_means_(0),
+      first_sweep_(true) {
+  if (config_->lbp_schedule != "serial") {
+    spdlog::warn("LBP schedule '{}' is not supported by lbp_llr, using 'serial'",
+                 config_->lbp_schedule);
+  }
+
+  if (std::is_integral<T>::value) {
+    // Factor -> RV messages are bounded by log(1 / epsilon), leave the same
+    // headroom again for the sums which make up RV -> factor messages
+    const double max_llr = 2.0 * std::log(1.0 / config_->epsilon);
+    step_ = max_llr / std::numeric_limits<T>::max();
+    // Rounding can leave messages a step apart forever, and one step moves
+    // P(RV = 1) by at most step / 4, so that much change still converges
+    tolerance_ = std::max(convergence_tol, 0.25 * step_);
+    spdlog::info("\tQuantized LLR messages: {} bytes, step {:.5f}, saturating at +-{:.2f}, "
+                 "convergence tolerance {:.5f}",
+                 sizeof(T), step_, max_llr, tolerance_);
+  }
+}
+
+template <>
+double LogFactorGraph<double>::toLLR(double msg) const {
+  return msg;
+}
+
+template <typename T>
+double LogFactorGraph<T>::toLLR(T msg) const {
+  return msg * step_;
+}
+
+template <>
+double LogFactorGraph<double>::fromLLR(double llr) const {
+  return llr;
+}
+
+template <typename T>
+T LogFactorGraph<T>::fromLLR(double llr) const {
+  // Round to the nearest step and saturate, NaN is stored as 0
+  const double max = std::numeric_limits<T>::max();
+  const double q = std::round(llr / step_);
+  return T(q > max ? max : (q < -max ? -max : (q == q ? q : 0.0)));
+}
+
+template <typename T>
+InferenceTool::Prediction LogFactorGraph<T>::predict(size_t v) const {
+  double llr = 0.0;
+  const auto &rv_edges = graph_->rvEdges();
+  for (size_t i = graph_->rvBegin(v); i < graph_->rvEnd(v); ++i) {
+    llr += toLLR(factor_llrs_[rv_edges[i]]);
+  }
+  return InferenceTool::Prediction(graph_->rvIndex(v), 1.0 / (1.0 + std::exp(-llr)));
+}
+
+template <typename T>
+std::vector<InferenceTool::Prediction> LogFactorGraph<T>::marginals() const {
+  std::vector<InferenceTool::Prediction> predictions;
+  predictions.reserve(graph_->numFactors());
+  for (size_t f = 0; f < graph_->numFactors(); ++f) {
+    predictions.push_back(predict(graph_->factorOutput(f)));
+  }
+  return predictions;
+}
+
+template <typename T>
+size_t LogFactorGraph<T>::memoryBytes() const {
+  using utils::Memory;
+  return InferenceTool::memoryBytes() + Memory::bytes(factor_llrs_) + Memory::bytes(rv_llrs_) +
+         Memory::bytes(mean_factor_llrs_) + Memory::bytes(mean_rv_llrs_);
+}
+
+template <typename T>
+void LogFactorGraph<T>::reconfigure(const VariableAssignments &observed) {
+  setObserved(observed);
+  // Warm-started messages are damped from the first sweep on, since they are
+  // already close to where BP is going
+  first_sweep_ = !startMessages();
+}
+
+template <typename T>
+double LogFactorGraph<T>::warmStartLLR(double llr) const {
+  const double max_llr = std::log(1.0 / warm_start_floor - 1.0);
+  return llr == llr ? std::min(max_llr, std::max(-max_llr, llr)) : 0.0;
+}
+
+template <typename T>
+bool LogFactorGraph<T>::startMessages() {
+  // Initial messages follow `lbp_warm_start`
+  const size_t num_edges = graph_->numEdges();
+  const std::string &warm_start = config_->lbp_warm_start;
+
+  if (warm_start == "previous" && factor_llrs_.size() == num_edges) {
+    for (auto &msg : factor_llrs_) msg = fromLLR(warmStartLLR(toLLR(msg)));
+    for (auto &msg : rv_llrs_) msg = fromLLR(warmStartLLR(toLLR(msg)));
+    return true;
+  }
+
+  if (warm_start == "average" && num_means_ > 0) {
+    for (size_t e = 0; e < num_edges; ++e) {
+      factor_llrs_[e] = fromLLR(mean_factor_llrs_[e]);
+      rv_llrs_[e] = fromLLR(mean_rv_llrs_[e]);
+    }
+    return true;
+  }
+
+  factor_llrs_.assign(num_edges, T(0));
+  rv_llrs_.assign(num_edges, T(0));
+  return false;
+}
+
+template <typename T>
+void LogFactorGraph<T>::accumulateMeans() {
+  if (config_->lbp_warm_start != "average") return;
+
+  if (num_means_ == 0) {
+    mean_factor_llrs_.assign(factor_llrs_.size(), 0.0);
+    mean_rv_llrs_.assign(rv_llrs_.size(), 0.0);
+  }
+  ++num_means_;
+
+  const auto accumulate = [this](std::vector<double> &means, const std::vector<T> &msgs) {
+    for (size_t e = 0; e < msgs.size(); ++e) {
+      means[e] += (warmStartLLR(toLLR(msgs[e])) - means[e]) / num_means_;
+    }
+  };
+  accumulate(mean_factor_llrs_, factor_llrs_);
+  accumulate(mean_rv_llrs_, rv_llrs_);
+}
+
+template <typename T>
+double LogFactorGraph<T>::updateMessage(T &msg, double new_msg) const {
+  const double prev = toLLR(msg);
+  // A message without a direction is not applied and cannot converge
+  if (std::isnan(new_msg)) return std::numeric_limits<double>::infinity();
+  if (first_sweep_) {
+    msg = fromLLR(new_msg);
+  } else {
+    const double damping = config_->lbp_damping;
+    msg = fromLLR(damping * new_msg + (1.0 - damping) * prev);
+  }
+  // Change of P(RV = 1), like the probability-domain engine, so saturated
+  // messages which still move in LLR can converge
+  const auto prob_one = [](double llr) { return 1.0 / (1.0 + std::exp(-llr)); };
+  return std::abs(prob_one(toLLR(msg)) - prob_one(prev));
+}
+
+template <typename T>
+void LogFactorGraph<T>::solve() {
+  PROFILE_SCOPE("solve");
+  spdlog::info("\tStarting log-domain loopy BP...");
+  const auto start = std::chrono::steady_clock::now();
+
+  size_t itr = 0, forward = 0;
+  for (itr = 0; itr < config_->lbp_max_iter; ++itr) {
+    PROFILE_SCOPE("lbp_iteration");
+    updateRandomVariableMessages(forward);
+    const double delta = updateFactorMessages(forward);
+    first_sweep_ = false;
+    PROFILE_COUNT("messages_updated", 2 * graph_->numEdges());
+    PROFILE_VALUE("lbp_residual", delta);
+    if (delta <= tolerance_) break;
+    forward = (forward + 1) % 2;
+  }
+
+  PROFILE_VALUE("lbp_iterations", std::min<size_t>(itr + 1, config_->lbp_max_iter));
+  if (itr >= config_->lbp_max_iter) {
+    spdlog::warn("\tLoopy BP did not converge, max iterations reached.");
+  } else {
+    spdlog::info("\tLoopy BP converged in {} iterations", itr + 1);
+  }
+  accumulateMeans();
+
+  spdlog::info("\tLBP finished in {:.3f} seconds.", utils::Convenience::seconds_since(start));
+}
+
+template <typename T>
+double LogFactorGraph<T>::updateFactorMessages(bool forward) {
+  const size_t num_factors = graph_->numFactors();
+  Observation obs[Factor::kMaxRVs];
+  double in[Factor::kMaxRVs], out[Factor::kMaxRVs];
+  double max_delta = 0.0;
+
+  for (size_t idx = 0; idx < num_factors; ++idx) {
+    const size_t f = forward ? idx : num_factors - idx - 1;
+    const FactorType type = graph_->factorType(f);
+    if (type == FactorType::UNSUPPORTED) continue;
+
+    const size_t begin = graph_->factorBegin(f);
+    const size_t n = graph_->factorEnd(f) - begin;
+    for (size_t i = 0; i < n; ++i) {
+      obs[i] = rv_obs_[graph_->edgeRV(begin + i)];
+      in[i] = toLLR(rv_llrs_[begin + i]);
+    }
+
+    prob_->factorLLRs(type, obs[0], obs, in, out, n);
+    for (size_t i = 0; i < n; ++i) {
+      const double delta = updateMessage(factor_llrs_[begin + i], out[i]);
+      if (delta > max_delta) max_delta = delta;
+    }
+  }
+  return max_delta;
+}
+
+template <typename T>
+void LogFactorGraph<T>::updateRandomVariableMessages(bool forward) {
+  const size_t num_rvs = graph_->numRVs();
+  const auto &rv_edges = graph_->rvEdges();
+
+  for (size_t idx = 0; idx < num_rvs; ++idx) {
+    const size_t v = forward ? idx : num_rvs - idx - 1;
+    const size_t begin = graph_->rvBegin(v);
+    const size_t end = graph_->rvEnd(v);
+
+    // Sum once, then leave out each recipient's own contribution
+    double total = 0.0;
+    for (size_t i = begin; i < end; ++i) total += toLLR(factor_llrs_[rv_edges[i]]);
+    for (size_t i = begin; i < end; ++i) {
+      const size_t e = rv_edges[i];
+      updateMessage(rv_llrs_[e], total - toLLR(factor_llrs_[e]));
+    }
+  }
+}
+
+template class LogFactorGraph<double>;
+template class LogFactorGraph<int16_t>;
+template class LogFactorGraph<int8_t>;
+
+}  // end namespace hash_reversal
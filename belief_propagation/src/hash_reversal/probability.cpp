@@ -12,46 +12,100 @@
 
 #include "hash_reversal/probability.hpp"
 
+#include <algorithm>
+#include <cmath>
+
+#include "hash_reversal/factor_kernels.hpp"
+
 namespace hash_reversal {
 
-Probability::Probability(std::shared_ptr<utils::Config> config) : config_(config) {}
+Probability::Probability(std::shared_ptr<utils::Config> config) : config_(config) {
+  for (size_t type = 0; type < tables_.size(); ++type) {
+    for (size_t obs = 0; obs < 3; ++obs) {
+      for (size_t i = 0; i < 8; ++i) {
+        tables_[type][obs][i] = probOne(FactorType(type), Observation(obs), (i >> 2) & 1,
+                                        (i >> 1) & 1, i & 1);
+      }
+    }
+  }
+}
 
-double Probability::probOne(const Factor &factor, const VariableAssignments &assignments,
-                            const VariableAssignments &observed) const {
+double Probability::probOne(FactorType type, Observation out_obs, bool out, bool in1,
+                            bool in2) const {
   const double eps = config_->epsilon;
 
   double assignment_prob = 0.5;
-  const std::string &factor_type = factor.factor_type;
-  const auto values = factor.extract(assignments);
-  const bool is_observed = observed.count(factor.output_rv) > 0u;
-  const bool observed_val = is_observed ? observed.at(factor.output_rv) : false;
-  if (is_observed && values.out != observed_val) return eps;
-
-  if (factor_type == "AND") {
-    if (values.out == 0) {
-      assignment_prob = values.out == (values.in1 & values.in2) ? 1.0 / 3.0 : 0;
-    } else {
-      assignment_prob = values.out == (values.in1 & values.in2);
-    }
+  const bool is_observed = out_obs != UNOBSERVED;
+  const bool observed_val = out_obs == OBSERVED_ONE;
+  if (is_observed && out != observed_val) return eps;
 
-  } else if (factor_type == "INV") {
-    assignment_prob = values.out != values.in1;
+  switch (type) {
+    case FactorType::AND:
+      if (out == 0) {
+        assignment_prob = out == (in1 & in2) ? 1.0 / 3.0 : 0;
+      } else {
+        assignment_prob = out == (in1 & in2);
+      }
+      break;
 
-  } else if (factor_type == "SAME") {
-    assignment_prob = values.out == values.in1;
+    case FactorType::INV:
+      assignment_prob = out != in1;
+      break;
 
-  } else if (factor_type == "PRIOR") {
-    if (is_observed) {
-      assignment_prob = observed_val ? 1.0 - eps : eps;
-    } else {
-      assignment_prob = 0.5;
-    }
+    case FactorType::SAME:
+      assignment_prob = out == in1;
+      break;
 
-  } else {
-    spdlog::error("Unsupported factor: {}", factor_type);
+    case FactorType::PRIOR:
+      if (is_observed) {
+        assignment_prob = observed_val ? 1.0 - eps : eps;
+      } else {
+        assignment_prob = 0.5;
+      }
+      break;
+
+    case FactorType::UNSUPPORTED:
+      break;
   }
 
   return std::max(eps, std::min(1.0 - eps, assignment_prob));
 }
 
-}  // end namespace hash_reversal
\ No newline at end of file
+void Probability::factorMessages(FactorType type, Observation out_obs, const Message *in,
+                                 Message *out) const {
+  const double *t = tables_[size_t(type)][out_obs].data();
+
+  switch (type) {
+    case FactorType::AND:
+      kernels::andMessages(t, in, out);
+      break;
+    case FactorType::INV:
+    case FactorType::SAME:
+      kernels::unaryMessages(t, in, out);
+      break;
+    case FactorType::PRIOR:
+      kernels::priorMessages(t, out);
+      break;
+    case FactorType::UNSUPPORTED:
+      break;
+  }
+}
+
+void Probability::factorLLRs(FactorType type, Observation out_obs, const Observation *obs,
+                             const double *in, double *out, size_t n) const {
+  Message p[Factor::kMaxRVs], m[Factor::kMaxRVs];
+
+  for (size_t i = 0; i < n; ++i) {
+    if (obs[i] == UNOBSERVED) {
+      // Logistic function evaluated so that exp() can only overflow to +inf
+      p[i] = {1.0 / (1.0 + std::exp(in[i])), 1.0 / (1.0 + std::exp(-in[i]))};
+    } else {
+      p[i] = {obs[i] == OBSERVED_ZERO ? 1.0 : 0.0, obs[i] == OBSERVED_ONE ? 1.0 : 0.0};
+    }
+  }
+
+  factorMessages(type, out_obs, p, m);
+  for (size_t i = 0; i < n; ++i) out[i] = std::log(m[i][1]) - std::log(m[i][0]);
+}
+
+}  // end namespace hash_reversal
@@ -0,0 +1,383 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "hash_reversal/topology.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include "utils/convenience.hpp"
+#include "utils/memory.hpp"
+
+namespace hash_reversal {
+
+namespace {
+
+static_assert(sizeof(size_t) == sizeof(uint64_t), "Binary graphs store size_t as 64 bits");
+
+//! Identifies binary graph files, the last character is the format version
+constexpr char kMagic[8] = {'H', 'R', 'G', 'R', 'A', 'P', 'H', '2'};
+
+//! Magic, checksum of the source text and checksum of the arrays after it
+constexpr size_t kHeaderSize = sizeof(kMagic) + 2 * sizeof(uint64_t);
+
+//! Writes the length and elements of `v`, padded to a multiple of 8 bytes
+template <typename T>
+void writeArray(std::ostream &out, const std::vector<T> &v) {
+  static const char padding[8] = {};
+  const uint64_t n = v.size();
+  out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+  out.write(reinterpret_cast<const char *>(v.data()), n * sizeof(T));
+  out.write(padding, (8 - (n * sizeof(T)) % 8) % 8);
+}
+
+//! Whether `v` never decreases, or strictly increases
+bool isSorted(const std::vector<size_t> &v, bool strict) {
+  for (size_t i = 1; i < v.size(); ++i) {
+    if (v[i] < v[i - 1] || (strict && v[i] == v[i - 1])) return false;
+  }
+  return true;
+}
+
+//! Reads an array written by writeArray(), false if it would run past `end`
+template <typename T>
+bool readArray(const char *&pos, const char *end, std::vector<T> &v) {
+  uint64_t n = 0;
+  if (end - pos < 8) return false;
+  std::memcpy(&n, pos, sizeof(n));
+  pos += sizeof(n);
+
+  const size_t available = end - pos;
+  if (n > available / sizeof(T)) return false;
+  const size_t bytes = n * sizeof(T);
+  const size_t padded = (bytes + 7) / 8 * 8;
+  if (padded > available) return false;
+
+  v.resize(n);
+  if (bytes > 0) std::memcpy(v.data(), pos, bytes);
+  pos += padded;
+  return true;
+}
+
+}  // namespace
+
+Topology::Topology() : factor_offsets_({0}), rv_offsets_({0}), level_offsets_({0}) {}
+
+Topology::Topology(const std::map<size_t, Factor> &factors) {
+  // Assign dense RV IDs in order of the original RV index
+  std::set<size_t> all_rvs;
+  for (auto &itr : factors) {
+    all_rvs.insert(itr.second.referenced_rvs.begin(), itr.second.referenced_rvs.end());
+  }
+
+  rv_indices_.assign(all_rvs.begin(), all_rvs.end());
+  const size_t max_rv_index = rv_indices_.empty() ? 0 : rv_indices_.back() + 1;
+  dense_rvs_.assign(max_rv_index, npos);
+  for (size_t v = 0; v < rv_indices_.size(); ++v) dense_rvs_[rv_indices_[v]] = v;
+
+  // Factor -> RV adjacency, the edge ID is the position in the flat edge list
+  factor_names_.reserve(factors.size());
+  factor_types_.reserve(factors.size());
+  factor_outputs_.reserve(factors.size());
+  factor_offsets_.reserve(factors.size() + 1);
+  rv_factors_.assign(rv_indices_.size(), npos);
+  factor_offsets_.push_back(0);
+
+  for (auto &itr : factors) {
+    const Factor &factor = itr.second;
+    const size_t f = factor_types_.size();
+    const size_t out = dense_rvs_[factor.output_rv];
+    const auto name = std::find(type_names_.begin(), type_names_.end(), factor.factor_type);
+    factor_names_.push_back(uint8_t(name - type_names_.begin()));
+    if (name == type_names_.end()) type_names_.push_back(factor.factor_type);
+    factor_types_.push_back(factor.type);
+    factor_outputs_.push_back(out);
+    rv_factors_[out] = f;
+
+    edge_rv_.push_back(out);
+    edge_factor_.push_back(f);
+    for (size_t rv_index : factor.inputRVs()) {
+      edge_rv_.push_back(dense_rvs_[rv_index]);
+      edge_factor_.push_back(f);
+    }
+    factor_offsets_.push_back(edge_rv_.size());
+  }
+
+  // RV -> edge adjacency, built with a counting sort over the edge list
+  rv_offsets_.assign(rv_indices_.size() + 1, 0);
+  for (size_t v : edge_rv_) ++rv_offsets_[v + 1];
+  for (size_t v = 0; v < rv_indices_.size(); ++v) rv_offsets_[v + 1] += rv_offsets_[v];
+
+  std::vector<size_t> fill(rv_offsets_.begin(), rv_offsets_.end() - 1);
+  rv_edges_.resize(edge_rv_.size());
+  for (size_t e = 0; e < edge_rv_.size(); ++e) rv_edges_[fill[edge_rv_[e]]++] = e;
+
+  computeLevels();
+}
+
+Topology::Topology(const Topology &graph, const std::vector<uint8_t> &keep_factor)
+    : type_names_(graph.type_names_) {
+  // Dense IDs of the kept RVs, in the order of their IDs in `graph`
+  std::vector<size_t> rv_map(graph.numRVs(), npos);
+  for (size_t f = 0; f < graph.numFactors(); ++f) {
+    if (!keep_factor[f]) continue;
+    for (size_t e = graph.factorBegin(f); e < graph.factorEnd(f); ++e) rv_map[graph.edgeRV(e)] = 0;
+  }
+  for (size_t v = 0; v < graph.numRVs(); ++v) {
+    if (rv_map[v] == npos) continue;
+    rv_map[v] = rv_indices_.size();
+    rv_indices_.push_back(graph.rv_indices_[v]);
+  }
+  dense_rvs_.assign(graph.dense_rvs_.size(), npos);
+  for (size_t v = 0; v < rv_indices_.size(); ++v) dense_rvs_[rv_indices_[v]] = v;
+
+  rv_factors_.assign(rv_indices_.size(), npos);
+  factor_offsets_.push_back(0);
+  for (size_t f = 0; f < graph.numFactors(); ++f) {
+    if (!keep_factor[f]) continue;
+    const size_t core_f = factor_types_.size();
+    const size_t out = rv_map[graph.factor_outputs_[f]];
+    factor_names_.push_back(graph.factor_names_[f]);
+    factor_types_.push_back(graph.factor_types_[f]);
+    factor_outputs_.push_back(out);
+    rv_factors_[out] = core_f;
+    for (size_t e = graph.factorBegin(f); e < graph.factorEnd(f); ++e) {
+      edge_rv_.push_back(rv_map[graph.edgeRV(e)]);
+      edge_factor_.push_back(core_f);
+    }
+    factor_offsets_.push_back(edge_rv_.size());
+  }
+
+  // Edges of `graph` are sorted by factor and then RV, so the counting sort
+  // keeps them in the same order as in `graph`
+  rv_offsets_.assign(rv_indices_.size() + 1, 0);
+  for (size_t v : edge_rv_) ++rv_offsets_[v + 1];
+  for (size_t v = 0; v < rv_indices_.size(); ++v) rv_offsets_[v + 1] += rv_offsets_[v];
+
+  std::vector<size_t> fill(rv_offsets_.begin(), rv_offsets_.end() - 1);
+  rv_edges_.resize(edge_rv_.size());
+  for (size_t e = 0; e < edge_rv_.size(); ++e) rv_edges_[fill[edge_rv_[e]]++] = e;
+
+  computeLevels();
+}
+
+void Topology::computeLevels() {
+  // Kahn's algorithm, where the parents of a factor are the factors which
+  // compute its inputs and its children are the other factors of its output
+  const size_t num_factors = factor_types_.size();
+  std::vector<size_t> num_parents(num_factors, 0);
+  for (size_t f = 0; f < num_factors; ++f) {
+    for (size_t e = factorBegin(f) + 1; e < factorEnd(f); ++e) {
+      if (rv_factors_[edge_rv_[e]] != npos) ++num_parents[f];
+    }
+  }
+
+  std::vector<size_t> queue;
+  queue.reserve(num_factors);
+  for (size_t f = 0; f < num_factors; ++f) {
+    if (num_parents[f] == 0) queue.push_back(f);
+  }
+
+  factor_levels_.assign(num_factors, 0);
+  for (size_t idx = 0; idx < queue.size(); ++idx) {
+    const size_t f = queue[idx];
+    const size_t out = factor_outputs_[f];
+    for (size_t i = rv_offsets_[out]; i < rv_offsets_[out + 1]; ++i) {
+      const size_t child = edge_factor_[rv_edges_[i]];
+      if (child == f) continue;
+      factor_levels_[child] = std::max(factor_levels_[child], factor_levels_[f] + 1);
+      if (--num_parents[child] == 0) queue.push_back(child);
+    }
+  }
+
+  size_t num_levels = 0;
+  for (size_t f : queue) num_levels = std::max(num_levels, factor_levels_[f] + 1);
+
+  if (queue.size() < num_factors) {
+    spdlog::warn("Factor graph has a cycle, {} factors were put on the last level",
+                 num_factors - queue.size());
+    for (size_t f = 0; f < num_factors; ++f) {
+      if (num_parents[f] > 0) factor_levels_[f] = num_levels;
+    }
+    ++num_levels;
+  }
+
+  // Counting sort of the factors by level
+  level_offsets_.assign(num_levels + 1, 0);
+  for (size_t l : factor_levels_) ++level_offsets_[l + 1];
+  for (size_t l = 0; l < num_levels; ++l) level_offsets_[l + 1] += level_offsets_[l];
+
+  std::vector<size_t> fill(level_offsets_.begin(), level_offsets_.end() - 1);
+  level_factors_.resize(num_factors);
+  for (size_t f = 0; f < num_factors; ++f) level_factors_[fill[factor_levels_[f]]++] = f;
+}
+
+Factor Topology::factor(size_t f) const {
+  std::set<size_t> referenced_rvs;
+  for (size_t e = factorBegin(f); e < factorEnd(f); ++e) {
+    referenced_rvs.insert(rv_indices_[edge_rv_[e]]);
+  }
+  Factor result(factorName(f), rv_indices_[factor_outputs_[f]], referenced_rvs);
+  result.type = factor_types_[f];
+  return result;
+}
+
+size_t Topology::memoryBytes() const {
+  using utils::Memory;
+  return Memory::bytes(type_names_) + Memory::bytes(factor_names_) +
+         Memory::bytes(factor_types_) + Memory::bytes(factor_outputs_) +
+         Memory::bytes(factor_offsets_) + Memory::bytes(edge_rv_) + Memory::bytes(edge_factor_) +
+         Memory::bytes(rv_indices_) + Memory::bytes(dense_rvs_) + Memory::bytes(rv_factors_) +
+         Memory::bytes(rv_offsets_) + Memory::bytes(rv_edges_) + Memory::bytes(factor_levels_) +
+         Memory::bytes(level_offsets_) + Memory::bytes(level_factors_);
+}
+
+bool Topology::save(const std::string &file, uint64_t checksum) const {
+  // Write to a temporary file first, so that a concurrent load() never sees
+  // a partially written graph
+  const std::string tmp_file = file + ".tmp";
+  std::ofstream out(tmp_file, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!out) return false;
+
+  // The arrays are checksummed as well, so that a damaged cache is noticed
+  // even though the text it was made from has not changed
+  std::ostringstream payload(std::ios::out | std::ios::binary);
+  writeArray(payload, std::vector<uint64_t>{type_names_.size()});
+  for (const auto &name : type_names_) {
+    writeArray(payload, std::vector<char>(name.begin(), name.end()));
+  }
+  writeArray(payload, factor_names_);
+  writeArray(payload, factor_types_);
+  writeArray(payload, factor_outputs_);
+  writeArray(payload, factor_offsets_);
+  writeArray(payload, edge_rv_);
+  writeArray(payload, edge_factor_);
+  writeArray(payload, rv_indices_);
+  writeArray(payload, rv_factors_);
+  writeArray(payload, rv_offsets_);
+  writeArray(payload, rv_edges_);
+  writeArray(payload, factor_levels_);
+  writeArray(payload, level_offsets_);
+  writeArray(payload, level_factors_);
+
+  const std::string arrays = payload.str();
+  const uint64_t payload_checksum = utils::Convenience::checksum(arrays);
+  out.write(kMagic, sizeof(kMagic));
+  out.write(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+  out.write(reinterpret_cast<const char *>(&payload_checksum), sizeof(payload_checksum));
+  out.write(arrays.data(), arrays.size());
+
+  out.close();
+  if (!out || std::rename(tmp_file.c_str(), file.c_str()) != 0) {
+    std::remove(tmp_file.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool Topology::load(const std::string &file, uint64_t checksum) {
+  const int fd = ::open(file.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || size_t(st.st_size) < kHeaderSize) {
+    ::close(fd);
+    return false;
+  }
+
+  const size_t size = st.st_size;
+  void *mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) return false;
+
+  const char *pos = static_cast<const char *>(mapped);
+  const char *end = pos + size;
+  Topology graph;
+  uint64_t file_checksum = 0, payload_checksum = 0;
+  std::vector<uint64_t> num_names;
+  std::memcpy(&file_checksum, pos + sizeof(kMagic), sizeof(file_checksum));
+  std::memcpy(&payload_checksum, pos + sizeof(kMagic) + sizeof(file_checksum),
+              sizeof(payload_checksum));
+  pos += kHeaderSize;
+  bool ok = std::memcmp(mapped, kMagic, sizeof(kMagic)) == 0 && file_checksum == checksum &&
+            utils::Convenience::checksum(pos, end - pos) == payload_checksum;
+
+  ok = ok && readArray(pos, end, num_names) && num_names.size() == 1;
+  for (uint64_t i = 0; ok && i < num_names[0]; ++i) {
+    std::vector<char> name;
+    ok = readArray(pos, end, name);
+    graph.type_names_.emplace_back(name.begin(), name.end());
+  }
+  ok = ok && readArray(pos, end, graph.factor_names_) && readArray(pos, end, graph.factor_types_) &&
+       readArray(pos, end, graph.factor_outputs_) && readArray(pos, end, graph.factor_offsets_) &&
+       readArray(pos, end, graph.edge_rv_) && readArray(pos, end, graph.edge_factor_) &&
+       readArray(pos, end, graph.rv_indices_) && readArray(pos, end, graph.rv_factors_) &&
+       readArray(pos, end, graph.rv_offsets_) && readArray(pos, end, graph.rv_edges_) &&
+       readArray(pos, end, graph.factor_levels_) && readArray(pos, end, graph.level_offsets_) &&
+       readArray(pos, end, graph.level_factors_);
+  ::munmap(mapped, size);
+
+  // Sanity check that the arrays fit together before trusting any index, in
+  // case the file was written by a buggy or different build
+  const size_t num_rvs = graph.rv_indices_.size();
+  const size_t num_factors = graph.factor_types_.size();
+  const size_t num_edges = graph.edge_rv_.size();
+  const size_t num_levels = graph.level_offsets_.empty() ? 0 : graph.level_offsets_.size() - 1;
+  ok = ok && pos == end && graph.factor_names_.size() == num_factors &&
+       graph.factor_outputs_.size() == num_factors &&
+       graph.factor_offsets_.size() == num_factors + 1 &&
+       graph.factor_offsets_.back() == num_edges && graph.edge_factor_.size() == num_edges &&
+       graph.rv_factors_.size() == num_rvs && graph.rv_offsets_.size() == num_rvs + 1 &&
+       graph.rv_edges_.size() == num_edges && graph.factor_levels_.size() == num_factors &&
+       graph.rv_offsets_.back() == num_edges && !graph.level_offsets_.empty() &&
+       graph.level_offsets_.back() == num_factors && graph.level_factors_.size() == num_factors &&
+       graph.factor_offsets_.front() == 0 && graph.rv_offsets_.front() == 0 &&
+       graph.level_offsets_.front() == 0 && isSorted(graph.factor_offsets_, false) &&
+       isSorted(graph.rv_offsets_, false) && isSorted(graph.level_offsets_, false) &&
+       isSorted(graph.rv_indices_, true) && (num_rvs == 0 || graph.rv_indices_.back() < npos);
+  for (size_t f = 0; ok && f < num_factors; ++f) {
+    // The message kernels read exactly the edges of the factor's type
+    ok = graph.factor_names_[f] < graph.type_names_.size() &&
+         graph.factor_types_[f] < FactorType::UNSUPPORTED &&
+         graph.factorEnd(f) - graph.factorBegin(f) == Factor::numRVs(graph.factor_types_[f]) &&
+         graph.factor_outputs_[f] < num_rvs && graph.factor_levels_[f] < num_levels &&
+         graph.level_factors_[f] < num_factors;
+  }
+  for (size_t v = 0; ok && v < num_rvs; ++v) {
+    ok = graph.rv_factors_[v] == npos || graph.rv_factors_[v] < num_factors;
+  }
+  for (size_t e = 0; ok && e < num_edges; ++e) {
+    ok = graph.edge_rv_[e] < num_rvs && graph.edge_factor_[e] < num_factors &&
+         graph.rv_edges_[e] < num_edges;
+  }
+  if (!ok) return false;
+
+  const size_t max_rv_index = num_rvs == 0 ? 0 : graph.rv_indices_.back() + 1;
+  graph.dense_rvs_.assign(max_rv_index, npos);
+  for (size_t v = 0; v < num_rvs; ++v) graph.dense_rvs_[graph.rv_indices_[v]] = v;
+
+  *this = std::move(graph);
+  return true;
+}
+
+}  // end namespace hash_reversal
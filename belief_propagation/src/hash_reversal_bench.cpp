@@ -0,0 +1,271 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+/*
+ * Micro-benchmarks of the building blocks of the solver: loading the dataset
+ * and the graph, unit propagation, single RV and factor message sweeps,
+ * marginals and a full solve with the serial `lbp` method, and a full solve
+ * of `batch_size` samples with `lbp_batch` for each set of kernels the CPU
+ * supports.
+ *
+ * Usage: hash_reversal_bench [--repeat N] [--synthetic NUM_GATES]... [config.yaml]...
+ *
+ * Without arguments it runs on random circuits of 1k, 10k and 100k gates,
+ * which are written to `bench_data/`. Every timing is the median of N runs
+ * (default 11), and is also reported per edge (or RV) update.
+ */
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hash_reversal/batch_factor_graph.hpp"
+#include "hash_reversal/circuit_simulator.hpp"
+#include "hash_reversal/dataset.hpp"
+#include "hash_reversal/factor_graph.hpp"
+#include "hash_reversal/probability.hpp"
+#include "hash_reversal/topology.hpp"
+#include "utils/config.hpp"
+
+namespace hash_reversal {
+
+//! Access to the message sweeps of a `FactorGraph`
+class FactorGraphBenchmark {
+ public:
+  explicit FactorGraphBenchmark(FactorGraph &fg) : fg_(fg) {}
+
+  void rvSweep(bool forward) { fg_.updateRandomVariableMessages(forward); }
+
+  void factorSweep(bool forward) { fg_.updateFactorMessages(forward); }
+
+  size_t numEdges() const { return fg_.core_->numEdges(); }
+
+ private:
+  FactorGraph &fg_;
+};
+
+}  // end namespace hash_reversal
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+//! Median time of `repeat` calls of `fn` in nanoseconds, `setup` runs untimed before each
+double medianNs(size_t repeat, const std::function<void(size_t)> &setup,
+                const std::function<void(size_t)> &fn) {
+  std::vector<double> times;
+  for (size_t r = 0; r < repeat; ++r) {
+    setup(r);
+    const auto start = Clock::now();
+    fn(r);
+    times.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+  }
+  std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+  return times[times.size() / 2];
+}
+
+void report(const char *name, double ns, double num_updates, const char *unit) {
+  std::printf("  %-12s %12.1f us %10.2f ns/%s\n", name, ns * 1e-3,
+              ns / std::max(1.0, num_updates), unit);
+}
+
+/*
+ * Writes a random circuit of 64 inputs and `num_gates` AND / INV gates, with
+ * its last 64 RVs observed, and 64 samples of it. Gate inputs are drawn from
+ * the 512 preceding RVs, so the depth grows with the number of gates. Returns
+ * the path of a config file which solves it.
+ */
+std::string writeSyntheticDataset(const std::filesystem::path &dir, size_t num_gates) {
+  constexpr size_t kInputs = 64, kWindow = 512, kSamples = 64;
+  std::filesystem::create_directories(dir);
+  std::mt19937_64 rng(num_gates);
+
+  const size_t num_rvs = kInputs + num_gates;
+  std::ofstream factors(dir / "factors.txt");
+  for (size_t rv = 0; rv < kInputs; ++rv) factors << "PRIOR;" << rv << "\n";
+  for (size_t rv = kInputs; rv < num_rvs; ++rv) {
+    const size_t first = rv > kWindow ? rv - kWindow : 0;
+    const auto pick = [&]() { return first + rng() % (rv - first); };
+    const size_t a = pick();
+    if (rng() % 4 == 0) {
+      factors << "INV;" << rv << ";" << a << "\n";
+    } else {
+      size_t b = pick();
+      while (b == a) b = pick();
+      factors << "AND;" << rv << ";" << a << ";" << b << "\n";
+    }
+  }
+  factors.close();
+
+  std::ofstream params(dir / "params.yaml");
+  params << "hash: synthetic\nnum_input_bits: " << kInputs << "\nnum_bits_per_sample: " << num_rvs
+         << "\nnum_samples: " << kSamples << "\ndifficulty: 1\nobserved_rv_indices: [";
+  for (size_t rv = num_rvs - 64; rv < num_rvs; ++rv) {
+    params << rv << (rv + 1 < num_rvs ? ", " : "]\n");
+  }
+  params.close();
+
+  // One simulator pass gives all 64 samples
+  const auto graph = std::make_shared<const hash_reversal::Topology>(
+      hash_reversal::Dataset::loadFactorGraph((dir / "factors.txt").string()));
+  const hash_reversal::CircuitSimulator simulator(graph);
+  std::vector<uint64_t> words(graph->numRVs(), 0);
+  for (size_t v : simulator.inputs()) words[v] = rng();
+  simulator.evaluate(words.data(), 1);
+
+  std::vector<uint8_t> bytes(kSamples * num_rvs / 8, 0);
+  for (size_t s = 0, bit = 0; s < kSamples; ++s) {
+    for (size_t rv = 0; rv < num_rvs; ++rv, ++bit) {
+      if ((words[graph->denseRV(rv)] >> s) & 1) bytes[bit / 8] |= uint8_t(0x80 >> (bit % 8));
+    }
+  }
+  std::ofstream data(dir / "data.bits", std::ios::out | std::ios::binary);
+  data.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  data.close();
+
+  const std::filesystem::path config_file = dir / "bench.yaml";
+  std::ofstream config(config_file);
+  config << "lbp_max_iter: 50\nlbp_damping: 0.75\nlbp_schedule: \"serial\"\n"
+         << "lbp_quantization: \"none\"\nlbp_compaction: false\nlbp_warm_start: \"cold\"\n"
+         << "num_threads: 1\nbatch_size: 8\nnum_workers: 1\ndataset_streaming: false\n"
+         << "sample_offset: 0\n"
+         << "sample_stride: 1\ndataset_dir: \"" << std::filesystem::absolute(dir).string()
+         << "\"\nepsilon: 0.0001\nnum_test: " << kSamples
+         << "\nprint_connections: false\ntest_mode: false\nmethod: \"lbp\"\n";
+  config.close();
+  return config_file.string();
+}
+
+bool runBenchmarks(const std::string &name, const std::string &config_file, size_t repeat) {
+  // Every config replaces the default logger with a new file logger
+  const auto config = std::make_shared<utils::Config>(config_file);
+  if (!config->valid()) {
+    spdlog::error("Skipping invalid config '{}'", config_file);
+    return false;
+  }
+  spdlog::set_level(spdlog::level::warn);
+
+  // The benchmarks measure the serial LBP kernels
+  config->method = "lbp";
+  config->lbp_schedule = "serial";
+
+  const auto dataset = std::make_shared<hash_reversal::Dataset>(config);
+  const auto prob = std::make_shared<hash_reversal::Probability>(config);
+  const auto graph = hash_reversal::InferenceTool::loadGraph(*dataset, *config);
+  hash_reversal::FactorGraph fg(prob, dataset, config, graph);
+  hash_reversal::InferenceTool &tool = fg;
+  hash_reversal::FactorGraphBenchmark bench(fg);
+
+  const size_t num_samples = dataset->numSamples();
+  std::vector<hash_reversal::VariableAssignments> observed;
+  for (size_t s = 0; s < std::min<size_t>(num_samples, repeat); ++s) {
+    observed.push_back(tool.propagateObserved(dataset->getObservedData(s)));
+  }
+  const auto sample = [&](size_t r) { return observed[r % observed.size()]; };
+  const auto nothing = [](size_t) {};
+
+  tool.reconfigure(sample(0));
+  const double edges = bench.numEdges();
+  std::printf("%s: %zu RVs, %zu factors, %zu edges, %.1f bytes of messages per edge\n",
+              name.c_str(), graph->numRVs(), graph->numFactors(), graph->numEdges(),
+              tool.memoryBytes() / std::max(1.0, edges));
+
+  report("dataset", medianNs(repeat, nothing, [&](size_t) { hash_reversal::Dataset d(config); }),
+         num_samples, "sample");
+
+  report("load_graph", medianNs(repeat, nothing, [&](size_t) {
+           hash_reversal::Dataset::loadFactorGraph(config->graph_file);
+         }), graph->numEdges(), "edge");
+
+  report("propagate", medianNs(repeat, nothing, [&](size_t r) {
+           tool.propagateObserved(dataset->getObservedData(r % num_samples));
+         }), graph->numEdges(), "edge");
+
+  const auto reset = [&](size_t r) { tool.reconfigure(sample(r)); };
+  report("rv_sweep", medianNs(repeat, reset, [&](size_t) { bench.rvSweep(true); }), edges, "edge");
+
+  report("factor_sweep", medianNs(repeat, [&](size_t r) {
+           reset(r);
+           bench.rvSweep(true);
+         }, [&](size_t) { bench.factorSweep(true); }), edges, "edge");
+
+  size_t updates = 0;
+  const double solve_ns = medianNs(repeat, reset, [&](size_t) {
+    tool.solve();
+    updates += 2 * bench.numEdges() * fg.iterations();
+  });
+  report("solve", solve_ns, updates / double(repeat), "edge");
+
+  report("marginals", medianNs(repeat, nothing, [&](size_t) { tool.marginals(); }),
+         graph->numRVs(), "RV");
+
+  // Batched solves, reported per edge update like the serial solve
+  std::vector<hash_reversal::VariableAssignments> batch_observed;
+  for (size_t lane = 0; lane < config->batch_size; ++lane) batch_observed.push_back(sample(lane));
+  hash_reversal::BatchFactorGraph batch(prob, dataset, config, graph);
+  for (const auto &kernels : hash_reversal::supportedBatchKernels()) {
+    batch.setKernels(kernels);
+    size_t batch_updates = 0;
+    const double batch_ns = medianNs(repeat, [&](size_t) { batch.reconfigure(batch_observed); },
+                                     [&](size_t) {
+                                       batch.solve();
+                                       for (size_t itr : batch.iterations()) {
+                                         batch_updates += 2 * bench.numEdges() * itr;
+                                       }
+                                     });
+    report(("batch_" + std::string(kernels.name)).c_str(), batch_ns,
+           batch_updates / double(repeat), "edge");
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t repeat = 11;
+  std::vector<size_t> synthetic;
+  std::vector<std::string> configs;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--repeat" && i + 1 < argc) {
+      repeat = std::max(1ul, std::stoul(argv[++i]));
+    } else if (arg == "--synthetic" && i + 1 < argc) {
+      synthetic.push_back(std::stoul(argv[++i]));
+    } else if (arg.rfind("--", 0) == 0) {
+      spdlog::error("Usage: {} [--repeat N] [--synthetic NUM_GATES]... [config.yaml]...",
+                    argv[0]);
+      return 1;
+    } else {
+      configs.push_back(arg);
+    }
+  }
+  if (synthetic.empty() && configs.empty()) synthetic = {1000, 10000, 100000};
+
+  std::filesystem::create_directories("logs");
+  bool ok = true;
+  for (size_t num_gates : synthetic) {
+    const std::string name = "synthetic_" + std::to_string(num_gates);
+    ok &= runBenchmarks(name, writeSyntheticDataset("bench_data/" + name, num_gates), repeat);
+  }
+  for (const auto &config_file : configs) ok &= runBenchmarks(config_file, config_file, repeat);
+  return ok ? 0 : 1;
+}
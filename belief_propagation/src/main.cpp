@@ -11,18 +11,184 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <boost/dynamic_bitset.hpp>
 #include <cmath>
 #include <memory>
+#include <numeric>
+#include <thread>
 #include <vector>
 
+#include "hash_reversal/batch_factor_graph.hpp"
+#include "hash_reversal/circuit_simulator.hpp"
+#include "hash_reversal/column_store.hpp"
 #include "hash_reversal/dataset.hpp"
 #include "hash_reversal/factor_graph.hpp"
 #include "hash_reversal/inference_tool.hpp"
+#include "hash_reversal/log_factor_graph.hpp"
 #include "hash_reversal/probability.hpp"
+#include "hash_reversal/topology.hpp"
 #include "utils/config.hpp"
+#include "utils/memory.hpp"
+#include "utils/profiler.hpp"
 #include "utils/stats.hpp"
 
+namespace {
+
+std::shared_ptr<hash_reversal::InferenceTool> createInferenceTool(
+    std::shared_ptr<hash_reversal::Probability> prob,
+    std::shared_ptr<hash_reversal::Dataset> dataset, std::shared_ptr<utils::Config> config,
+    std::shared_ptr<const hash_reversal::Topology> graph) {
+  std::shared_ptr<hash_reversal::InferenceTool> inference_tool;
+
+  if (config->method == "lbp") {
+    inference_tool = std::shared_ptr<hash_reversal::InferenceTool>(
+        new hash_reversal::FactorGraph(prob, dataset, config, graph));
+  } else if (config->method == "lbp_llr" && config->lbp_quantization == "int16") {
+    inference_tool = std::shared_ptr<hash_reversal::InferenceTool>(
+        new hash_reversal::LogFactorGraph<int16_t>(prob, dataset, config, graph));
+  } else if (config->method == "lbp_llr" && config->lbp_quantization == "int8") {
+    inference_tool = std::shared_ptr<hash_reversal::InferenceTool>(
+        new hash_reversal::LogFactorGraph<int8_t>(prob, dataset, config, graph));
+  } else if (config->method == "lbp_llr") {
+    inference_tool = std::shared_ptr<hash_reversal::InferenceTool>(
+        new hash_reversal::LogFactorGraph<double>(prob, dataset, config, graph));
+  } else if (config->method == "lbp_batch") {
+    inference_tool = std::shared_ptr<hash_reversal::InferenceTool>(
+        new hash_reversal::BatchFactorGraph(prob, dataset, config, graph));
+  }
+
+  return inference_tool;
+}
+
+/*
+ * Bytes held by each subsystem, summed over the workers. Subsystems which do
+ * not exist yet are left out.
+ */
+utils::Memory::Usage memoryUsage(
+    const hash_reversal::Dataset &dataset, std::shared_ptr<const hash_reversal::Topology> graph,
+    const std::vector<std::shared_ptr<hash_reversal::InferenceTool>> &inference_tools,
+    const std::vector<size_t> &marginal_bytes, const std::vector<utils::Stats> &stats) {
+  utils::Memory::Usage usage{{"samples", dataset.memoryBytes()}};
+  if (graph) usage.emplace_back("topology", graph->memoryBytes());
+  if (!inference_tools.empty()) {
+    size_t bytes = 0;
+    for (const auto &tool : inference_tools) bytes += tool->memoryBytes();
+    usage.emplace_back("messages", bytes);
+  }
+  if (!marginal_bytes.empty()) {
+    usage.emplace_back("marginals",
+                       std::accumulate(marginal_bytes.begin(), marginal_bytes.end(), size_t(0)));
+  }
+  if (!stats.empty()) {
+    size_t bytes = 0;
+    for (const auto &s : stats) bytes += s.memoryBytes();
+    usage.emplace_back("stats", bytes);
+  }
+  return usage;
+}
+
+/*
+ * Solves the test samples [begin, end) with a single inference tool and
+ * records the results in `stats`. `marginal_bytes` is set to the size of the
+ * largest set of marginals. Returns false if a predicted input did not
+ * validate while in test mode, and then sets `stop`. Every worker checks
+ * `stop` between samples, so that the first failure ends the whole run.
+ */
+bool runSamples(std::shared_ptr<hash_reversal::InferenceTool> inference_tool,
+                std::shared_ptr<hash_reversal::Dataset> dataset,
+                const hash_reversal::CircuitSimulator &simulator,
+                std::shared_ptr<utils::Config> config, size_t begin, size_t end,
+                size_t num_test, utils::Stats &stats, size_t &marginal_bytes,
+                std::atomic<bool> &stop) {
+  const size_t n_input = config->num_input_bits;
+  const auto batch_tool =
+      std::dynamic_pointer_cast<hash_reversal::BatchFactorGraph>(inference_tool);
+
+  // The batched method solves several samples at once, the others one by one
+  const size_t batch_size = batch_tool ? config->batch_size : 1;
+
+  // Observed bits and the means of the predicted RVs are read from a column
+  // store, built for one block of whole batches at a time so that memory does
+  // not grow with the number of samples
+  const size_t block_size = (batch_size + 63) / 64 * 64;
+  std::vector<size_t> predicted_rvs;
+  for (const auto &itr : inference_tool->factorTypes()) predicted_rvs.push_back(itr.first);
+  std::vector<size_t> column_rvs = predicted_rvs;
+  column_rvs.insert(column_rvs.end(), config->observed_rv_indices.begin(),
+                    config->observed_rv_indices.end());
+
+  for (size_t block_start = begin; block_start < end; block_start += block_size) {
+    const size_t block_end = std::min(end, block_start + block_size);
+    const hash_reversal::ColumnStore columns(*dataset, column_rvs, block_start, block_end);
+    for (size_t rv : predicted_rvs) stats.addNumOnes(rv, columns.countOnes(rv));
+
+    for (size_t batch_start = block_start; batch_start < block_end; batch_start += batch_size) {
+      if (stop) return true;
+      const size_t batch_end = std::min(block_end, batch_start + batch_size);
+      std::vector<hash_reversal::VariableAssignments> batch_observed;
+
+      for (size_t sample_idx = batch_start; sample_idx < batch_end; ++sample_idx) {
+        spdlog::info("Test case {}/{}", sample_idx + 1, num_test);
+        batch_observed.push_back(inference_tool->propagateObserved(
+            dataset->getObservedData(columns, block_start, sample_idx)));
+      }
+
+      if (batch_tool) {
+        batch_tool->reconfigure(batch_observed);
+        batch_tool->solve();
+      }
+
+      for (size_t lane = 0; lane < batch_observed.size(); ++lane) {
+        if (stop) return true;
+        const size_t sample_idx = batch_start + lane;
+        const auto &observed = batch_observed[lane];
+        std::vector<hash_reversal::InferenceTool::Prediction> marginals;
+        if (batch_tool) {
+          PROFILE_SCOPE("marginals");
+          marginals = batch_tool->marginals(lane);
+        } else {
+          inference_tool->reconfigure(observed);
+          inference_tool->solve();
+          PROFILE_SCOPE("marginals");
+          marginals = inference_tool->marginals();
+        }
+        marginal_bytes = std::max(marginal_bytes, utils::Memory::bytes(marginals));
+        boost::dynamic_bitset<> predicted_input(n_input);
+
+        const auto ground_truth = dataset->getFullSample(sample_idx);
+
+        {
+          PROFILE_SCOPE("stats");
+          for (const auto &prediction : marginals) {
+            const double p = prediction.prob_one;
+            const size_t rv = prediction.rv_index;
+            const bool predicted_val = p > 0.5 ? true : false;
+            const bool true_val = ground_truth[rv];
+            const bool is_observed = observed.count(rv) > 0;
+            stats.update(rv, predicted_val, true_val, p, is_observed);
+
+            if (dataset->isHashInputBit(rv)) {
+              predicted_input[rv] = predicted_val;
+            }
+          }
+        }
+
+        // Verify the predicted input creates a hash collision / pre-image
+        const bool valid = dataset->validate(simulator, predicted_input, sample_idx);
+        if (config->test_mode && !valid) {
+          stop = true;
+          return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+}  // namespace
+
 int main(int argc, char** argv) {
   if (argc < 2) {
     spdlog::error("You must provide a path to a YAML config file!");
@@ -42,58 +208,77 @@ int main(int argc, char** argv) {
       new hash_reversal::Dataset(config));
   const std::shared_ptr<hash_reversal::Probability> prob(
       new hash_reversal::Probability(config));
+  utils::Memory::log("loading the dataset", memoryUsage(*dataset, nullptr, {}, {}, {}),
+                     dataset->mappedBytes());
 
-  std::shared_ptr<hash_reversal::InferenceTool> inference_tool;
+  // How many hash input --> hash output trials to run
+  const size_t num_test = std::min<size_t>(config->num_test, dataset->numSamples());
+  const size_t num_workers = std::max<size_t>(1, std::min(config->num_workers, num_test));
 
-  if (config->method == "lbp") {
-    inference_tool = std::shared_ptr<hash_reversal::InferenceTool>(
-        new hash_reversal::FactorGraph(prob, dataset, config));
-  } else {
-    spdlog::error("Unsupported method: {}", config->method);
+  // The graph is read-only while solving, so all workers share one copy and
+  // only the message state is per worker
+  const auto graph = hash_reversal::InferenceTool::loadGraph(*dataset, *config);
+  std::vector<std::shared_ptr<hash_reversal::InferenceTool>> inference_tools;
+  for (size_t w = 0; w < num_workers; ++w) {
+    inference_tools.push_back(createInferenceTool(prob, dataset, config, graph));
+    if (!inference_tools.back()) {
+      spdlog::error("Unsupported method: {}", config->method);
+      return 1;
+    }
+  }
+
+  utils::Memory::log("loading the graph", memoryUsage(*dataset, graph, inference_tools, {}, {}),
+                     dataset->mappedBytes());
+
+  // Predicted inputs are validated by evaluating the circuit
+  const hash_reversal::CircuitSimulator simulator(graph);
+  if (!dataset->canValidate(simulator)) {
+    spdlog::error("Predicted inputs cannot be validated, exiting.");
     return 1;
   }
 
   spdlog::info("Checking accuracy on test data...");
-  const size_t n_input = config->num_input_bits;
 
-  // Initialize a helper object to track statistics while running the algo
-  utils::Stats stats(config, inference_tool->factorTypes());
+  // Initialize helper objects to track statistics while running the algo,
+  // one per worker since updating them is not thread-safe
+  std::vector<utils::Stats> stats;
+  stats.reserve(num_workers);
+  for (size_t w = 0; w < num_workers; ++w) {
+    stats.emplace_back(config, inference_tools[w]->factorTypes());
+  }
 
-  // How many hash input --> hash output trials to run
-  const size_t num_test = std::min<size_t>(config->num_test, config->num_samples);
-
-  for (size_t sample_idx = 0; sample_idx < num_test; ++sample_idx) {
-    spdlog::info("Test case {}/{}", sample_idx + 1, num_test);
-
-    auto observed = dataset->getObservedData(sample_idx);
-    observed = inference_tool->propagateObserved(observed);
-    inference_tool->reconfigure(observed);
-    inference_tool->solve();
-    const auto marginals = inference_tool->marginals();
-    boost::dynamic_bitset<> predicted_input(n_input);
-
-    const auto ground_truth = dataset->getFullSample(sample_idx);
-
-    for (const auto &prediction : marginals) {
-      const double p = prediction.prob_one;
-      const size_t rv = prediction.rv_index;
-      const bool predicted_val = p > 0.5 ? true : false;
-      const bool true_val = ground_truth[rv];
-      const bool is_observed = observed.count(rv) > 0;
-      stats.update(rv, predicted_val, true_val, p, is_observed);
-
-      if (dataset->isHashInputBit(rv)) {
-        predicted_input[rv] = predicted_val;
-      }
-    }
+  // Each worker takes a contiguous block of samples. Merging the statistics in
+  // worker order then gives the same output as solving everything serially.
+  std::vector<char> valid(num_workers, true);
+  std::vector<size_t> marginal_bytes(num_workers, 0);
+  std::atomic<bool> stop(false);
+  const auto run_worker = [&](size_t w) {
+    const size_t begin = num_test * w / num_workers;
+    const size_t end = num_test * (w + 1) / num_workers;
+    valid[w] = runSamples(inference_tools[w], dataset, simulator, config, begin, end, num_test,
+                           stats[w], marginal_bytes[w], stop);
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t w = 1; w < num_workers; ++w) workers.emplace_back(run_worker, w);
+  run_worker(0);
+  for (auto &worker : workers) worker.join();
+
+  utils::Memory::log("inference",
+                     memoryUsage(*dataset, graph, inference_tools, marginal_bytes, stats),
+                     dataset->mappedBytes());
+  if (std::count(valid.begin(), valid.end(), false) > 0) return 1;
 
-    // Verify the predicted input creates a hash collision / pre-image
-    const bool valid = dataset->validate(predicted_input, sample_idx);
-    if (config->test_mode && !valid) return 1;
+  {
+    PROFILE_SCOPE("stats");
+    for (size_t w = 1; w < num_workers; ++w) stats[0].merge(stats[w]);
+    stats[0].save();
   }
 
-  stats.save();
+  utils::Memory::logSummary(memoryUsage(*dataset, graph, inference_tools, marginal_bytes, stats),
+                            dataset->mappedBytes());
+  PROFILE_SAVE("profile.json", "trace.json");
 
   spdlog::info("Done.");
   return 0;
-}
\ No newline at end of file
+}
@@ -12,9 +12,16 @@
 
 #include "utils/config.hpp"
 
+#include <algorithm>
+#include <set>
+#include <thread>
+
+#include "utils/profiler.hpp"
+
 namespace utils {
 
 Config::Config(std::string config_file) : valid_(true) {
+  PROFILE_SCOPE("config");
   configureLogging();
   loadYAML(config_file);
   if (valid_) loadDatasetParameters();
@@ -32,11 +39,14 @@ void Config::configureLogging() const {
   oss << std::put_time(&tm, "logs/%Y-%m-%d-%H-%M-%S.log");
 
   std::vector<spdlog::sink_ptr> sinks;
-  sinks.push_back(std::make_shared<spdlog::sinks::stdout_sink_st>());
+  sinks.push_back(std::make_shared<spdlog::sinks::stdout_sink_mt>());
   sinks.push_back(std::make_shared<spdlog::sinks::basic_file_sink_mt>(oss.str()));
   auto logger =
       std::make_shared<spdlog::logger>("basic_logger", begin(sinks), end(sinks));
-  spdlog::register_logger(logger);
+  // Workers log through `spdlog::info` etc., so the thread-safe logger has to
+  // be the default one. The pattern is the default one without the name.
+  logger->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] %v");
+  spdlog::set_default_logger(logger);
 
   spdlog::set_level(spdlog::level::debug);
 }
@@ -85,6 +95,98 @@ void Config::loadYAML(const std::string &config_file) {
     spdlog::info("{} --> {}", param, lbp_damping);
   }
 
+  param = "lbp_schedule";
+  if (!data[param]) {
+    valid_ = false;
+    spdlog::error("Missing '{}'", param);
+  } else {
+    lbp_schedule = data[param].as<std::string>();
+    spdlog::info("{} --> {}", param, lbp_schedule);
+  }
+
+  param = "lbp_quantization";
+  if (!data[param]) {
+    valid_ = false;
+    spdlog::error("Missing '{}'", param);
+  } else {
+    lbp_quantization = data[param].as<std::string>();
+    spdlog::info("{} --> {}", param, lbp_quantization);
+  }
+
+  param = "lbp_compaction";
+  if (!data[param]) {
+    valid_ = false;
+    spdlog::error("Missing '{}'", param);
+  } else {
+    lbp_compaction = data[param].as<bool>();
+    spdlog::info("{} --> {}", param, lbp_compaction);
+  }
+
+  param = "lbp_warm_start";
+  if (!data[param]) {
+    valid_ = false;
+    spdlog::error("Missing '{}'", param);
+  } else {
+    lbp_warm_start = data[param].as<std::string>();
+    spdlog::info("{} --> {}", param, lbp_warm_start);
+  }
+
+  param = "num_threads";
+  if (!data[param]) {
+    valid_ = false;
+    spdlog::error("Missing '{}'", param);
+  } else {
+    num_threads = data[param].as<size_t>();
+    if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+    spdlog::info("{} --> {}", param, num_threads);
+  }
+
+  param = "batch_size";
+  if (!data[param]) {
+    valid_ = false;
+    spdlog::error("Missing '{}'", param);
+  } else {
+    batch_size = data[param].as<size_t>();
+    spdlog::info("{} --> {}", param, batch_size);
+  }
+
+  param = "num_workers";
+  if (!data[param]) {
+    valid_ = false;
+    spdlog::error("Missing '{}'", param);
+  } else {
+    num_workers = data[param].as<size_t>();
+    if (num_workers == 0) num_workers = std::max(1u, std::thread::hardware_concurrency());
+    spdlog::info("{} --> {}", param, num_workers);
+  }
+
+  param = "dataset_streaming";
+  if (!data[param]) {
+    valid_ = false;
+    spdlog::error("Missing '{}'", param);
+  } else {
+    dataset_streaming = data[param].as<bool>();
+    spdlog::info("{} --> {}", param, dataset_streaming);
+  }
+
+  param = "sample_offset";
+  if (!data[param]) {
+    valid_ = false;
+    spdlog::error("Missing '{}'", param);
+  } else {
+    sample_offset = data[param].as<size_t>();
+    spdlog::info("{} --> {}", param, sample_offset);
+  }
+
+  param = "sample_stride";
+  if (!data[param]) {
+    valid_ = false;
+    spdlog::error("Missing '{}'", param);
+  } else {
+    sample_stride = data[param].as<size_t>();
+    spdlog::info("{} --> {}", param, sample_stride);
+  }
+
   param = "dataset_dir";
   if (!data[param]) {
     valid_ = false;
@@ -222,6 +324,73 @@ void Config::validateParameters() {
     valid_ = false;
     spdlog::error("Number of samples is not a multiple of 8");
   }
+
+  if (!(lbp_damping > 0.0 && lbp_damping <= 1.0)) {
+    valid_ = false;
+    spdlog::error("LBP damping must be in (0, 1], got {}", lbp_damping);
+  }
+
+  if (!(epsilon > 0.0 && epsilon < 0.5)) {
+    valid_ = false;
+    spdlog::error("Epsilon must be in (0, 0.5), got {}", epsilon);
+  }
+
+  const std::set<std::string> schedules = {"serial", "flooding", "wavefront", "residual"};
+  if (schedules.count(lbp_schedule) == 0) {
+    valid_ = false;
+    spdlog::error("Unsupported LBP schedule: {}", lbp_schedule);
+  }
+
+  const std::set<std::string> quantizations = {"none", "int16", "int8"};
+  if (quantizations.count(lbp_quantization) == 0) {
+    valid_ = false;
+    spdlog::error("Unsupported LBP quantization: {}", lbp_quantization);
+  }
+
+  if (lbp_quantization != "none" && method != "lbp_llr") {
+    spdlog::warn("LBP quantization '{}' only applies to method 'lbp_llr'", lbp_quantization);
+  }
+
+  if (lbp_compaction && method != "lbp") {
+    spdlog::warn("LBP compaction only applies to method 'lbp'");
+  }
+
+  const std::set<std::string> warm_starts = {"cold", "previous", "average"};
+  if (warm_starts.count(lbp_warm_start) == 0) {
+    valid_ = false;
+    spdlog::error("Unsupported LBP warm start: {}", lbp_warm_start);
+  }
+
+  if (lbp_warm_start != "cold" && method != "lbp_llr") {
+    spdlog::warn("LBP warm start '{}' only applies to method 'lbp_llr'", lbp_warm_start);
+  }
+
+  if (batch_size == 0) {
+    valid_ = false;
+    spdlog::error("Batch size must be at least 1");
+  }
+
+  if (sample_stride == 0) {
+    valid_ = false;
+    spdlog::error("Sample stride must be at least 1");
+  }
+
+  if (sample_offset >= num_samples) {
+    valid_ = false;
+    spdlog::error("Sample offset {} is past the last sample", sample_offset);
+  }
+
+  // Every worker has its own pool of `num_threads` threads, so the workers
+  // share the cores between them instead of each one using all of them
+  const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  const size_t workers = std::max<size_t>(1, std::min(num_workers, num_test));
+  const bool pooled = method == "lbp" && (lbp_schedule == "flooding" || lbp_schedule == "wavefront");
+  const size_t threads = std::max<size_t>(1, cores / workers);
+  if (pooled && workers > 1 && threads < num_threads) {
+    spdlog::warn("{} workers with {} threads each oversubscribe {} cores, using {} threads per worker",
+                 workers, num_threads, cores, threads);
+    num_threads = threads;
+  }
 }
 
 }  // end namespace utils
\ No newline at end of file
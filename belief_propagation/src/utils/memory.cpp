@@ -0,0 +1,90 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "utils/memory.hpp"
+
+#include <spdlog/spdlog.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+namespace utils {
+
+namespace {
+
+double megabytes(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+}  // namespace
+
+size_t Memory::peakRSS() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  // Linux reports kilobytes
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+size_t Memory::currentRSS() {
+  // Second field of statm is the number of resident pages
+  std::ifstream statm("/proc/self/statm");
+  size_t pages = 0, resident = 0;
+  if (!(statm >> pages >> resident)) return 0;
+  return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t Memory::fileRSS() {
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  size_t kilobytes = 0;
+  while (status >> key) {
+    if (key == "RssFile:") {
+      status >> kilobytes;
+      return kilobytes * 1024;
+    }
+    status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return 0;
+}
+
+void Memory::log(const std::string &phase, const Usage &usage, size_t mapped) {
+  std::string line;
+  for (const auto &itr : usage) {
+    line += fmt::format("{} {:.1f} MB, ", itr.first, megabytes(itr.second));
+  }
+  if (mapped > 0) line += fmt::format("mapped {:.1f} MB, ", megabytes(mapped));
+  spdlog::info("Memory after {}: {}RSS {:.1f} MB, peak RSS {:.1f} MB", phase, line,
+               megabytes(currentRSS()), megabytes(peakRSS()));
+}
+
+void Memory::logSummary(const Usage &usage, size_t mapped) {
+  const size_t rss = currentRSS();
+  const size_t file_rss = std::min(fileRSS(), rss);
+  size_t accounted = file_rss;
+
+  spdlog::info("Memory summary:");
+  for (const auto &itr : usage) {
+    accounted += itr.second;
+    spdlog::info("\t{:<12} {:>10.1f} MB ({:.0f}% of RSS)", itr.first, megabytes(itr.second),
+                 rss > 0 ? 100.0 * itr.second / rss : 0.0);
+  }
+  spdlog::info("\t{:<12} {:>10.1f} MB", "other", megabytes(rss > accounted ? rss - accounted : 0));
+  spdlog::info("\t{:<12} {:>10.1f} MB (mapped in place, not counted above)", "mapped",
+               megabytes(mapped));
+  spdlog::info("\t{:<12} {:>10.1f} MB (mapped files and code, reclaimable)", "file RSS",
+               megabytes(file_rss));
+  spdlog::info("\t{:<12} {:>10.1f} MB", "RSS", megabytes(rss));
+  spdlog::info("\t{:<12} {:>10.1f} MB", "peak RSS", megabytes(peakRSS()));
+}
+
+}  // end namespace utils
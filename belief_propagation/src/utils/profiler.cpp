@@ -0,0 +1,150 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "utils/profiler.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace utils {
+
+void Profiler::Distribution::add(double x) {
+  if (!std::isfinite(x)) {
+    ++non_finite;
+    return;
+  }
+  min = count == 0 ? x : std::min(min, x);
+  max = count == 0 ? x : std::max(max, x);
+  sum += x;
+  ++count;
+}
+
+void Profiler::Distribution::merge(const Distribution &other) {
+  non_finite += other.non_finite;
+  if (other.count == 0) return;
+  min = count == 0 ? other.min : std::min(min, other.min);
+  max = count == 0 ? other.max : std::max(max, other.max);
+  sum += other.sum;
+  count += other.count;
+}
+
+Profiler::Profiler() : origin_(Clock::now()) {}
+
+Profiler &Profiler::instance() {
+  static Profiler profiler;
+  return profiler;
+}
+
+Profiler::ThreadData &Profiler::local() {
+  thread_local ThreadData *data = nullptr;
+  if (!data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    threads_.emplace_back(new ThreadData());
+    data = threads_.back().get();
+    data->tid = threads_.size() - 1;
+  }
+  return *data;
+}
+
+void Profiler::record(const char *phase, Clock::time_point start, Clock::time_point end) {
+  ThreadData &data = local();
+  const int64_t start_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin_).count();
+  const int64_t duration_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  if (data.events.size() < kMaxEvents) data.events.push_back({phase, start_ns, duration_ns});
+  data.phases[phase].add(duration_ns * 1e-6);
+}
+
+void Profiler::count(const char *counter, uint64_t n) { local().counters[counter] += n; }
+
+void Profiler::value(const char *name, double x) { local().values[name].add(x); }
+
+void Profiler::save(const std::string &summary_file, const std::string &trace_file) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Merge the threads by name, the same literal may have several addresses
+  std::map<std::string, Distribution> phases, values;
+  std::map<std::string, uint64_t> counters;
+  for (const auto &data : threads_) {
+    for (const auto &itr : data->phases) phases[itr.first].merge(itr.second);
+    for (const auto &itr : data->values) values[itr.first].merge(itr.second);
+    for (const auto &itr : data->counters) counters[itr.first] += itr.second;
+  }
+
+  // JSON has no infinity or NaN. The sum of finite values can still overflow.
+  const auto number = [](double x) {
+    std::ostringstream oss;
+    oss.precision(9);
+    if (std::isfinite(x)) {
+      oss << x;
+    } else {
+      oss << "null";
+    }
+    return oss.str();
+  };
+
+  const auto write_distributions = [&number](std::ofstream &out,
+                                             const std::map<std::string, Distribution> &dists,
+                                             const std::string &unit) {
+    bool first = true;
+    for (const auto &itr : dists) {
+      const Distribution &d = itr.second;
+      out << (first ? "" : ",") << "\n    \"" << itr.first << "\": {\"count\": " << d.count
+          << ", \"non_finite\": " << d.non_finite << ", \"total" << unit
+          << "\": " << number(d.sum) << ", \"mean" << unit
+          << "\": " << number(d.sum / std::max<uint64_t>(1, d.count)) << ", \"min" << unit
+          << "\": " << number(d.min) << ", \"max" << unit << "\": " << number(d.max) << "}";
+      first = false;
+    }
+  };
+
+  std::ofstream summary(summary_file);
+  summary << "{\n  \"phases\": {";
+  write_distributions(summary, phases, "_ms");
+  summary << "\n  },\n  \"counters\": {";
+  bool first = true;
+  for (const auto &itr : counters) {
+    summary << (first ? "" : ",") << "\n    \"" << itr.first << "\": " << itr.second;
+    first = false;
+  }
+  summary << "\n  },\n  \"values\": {";
+  write_distributions(summary, values, "");
+  summary << "\n  }\n}\n";
+  summary.close();
+
+  // Complete ("X") events with microsecond timestamps
+  std::ofstream trace(trace_file);
+  trace.precision(3);
+  trace << std::fixed << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  first = true;
+  for (const auto &data : threads_) {
+    for (const Event &event : data->events) {
+      trace << (first ? "" : ",") << "\n{\"name\": \"" << event.name
+            << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << data->tid
+            << ", \"ts\": " << event.start_ns * 1e-3 << ", \"dur\": " << event.duration_ns * 1e-3
+            << "}";
+      first = false;
+    }
+  }
+  trace << "\n]}\n";
+  trace.close();
+
+  spdlog::info("Profile was written to '{}' and '{}'", summary_file, trace_file);
+}
+
+}  // end namespace utils
@@ -0,0 +1,118 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+/*
+ * Checks that every lane of `BatchFactorGraph` gives exactly the marginals and
+ * iteration count of solving its sample alone with `FactorGraph`, for each set
+ * of kernels the CPU supports. The batch has lanes with different observations,
+ * contradictory ones among them, and does not fill its last chunk.
+ */
+
+#include <spdlog/spdlog.h>
+
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hash_reversal/batch_factor_graph.hpp"
+#include "hash_reversal/batch_kernels.hpp"
+#include "hash_reversal/dataset.hpp"
+#include "hash_reversal/factor_graph.hpp"
+#include "hash_reversal/probability.hpp"
+#include "test_utils.hpp"
+
+namespace {
+
+using hash_reversal::BatchFactorGraph;
+using hash_reversal::FactorGraph;
+using hash_reversal::VariableAssignments;
+using test_utils::check;
+
+constexpr size_t kInputs = 5, kBits = 16, kSamples = 8, kLanes = 11;
+
+/*
+ * RVs 0-4 are the input, RV 5 = 0 & 1, RV 6 = 1 & 2, RV 7 = ~5, RV 8 = 6 & 3,
+ * RV 9 = 4, RV 10 = 7 & 8, RV 11 = 9 & 10 and RV 12 = 5 & 6. RVs 5 and 6 share
+ * RV 1, so the graph has loops and LBP needs several iterations.
+ */
+const char *kFactors =
+    "PRIOR;0\nPRIOR;1\nPRIOR;2\nPRIOR;3\nPRIOR;4\nAND;5;0;1\nAND;6;1;2\nINV;7;5\n"
+    "AND;8;6;3\nSAME;9;4\nAND;10;7;8\nAND;11;9;10\nAND;12;5;6\n";
+
+//! Random observations of RVs 0-12, lane 0 observes nothing
+std::vector<VariableAssignments> observations() {
+  std::mt19937_64 rng(7);
+  std::vector<VariableAssignments> result(kLanes);
+  for (size_t lane = 1; lane < kLanes; ++lane) {
+    for (size_t rv = 0; rv <= 12; ++rv) {
+      const size_t value = rng() % 4;
+      if (value < 2) result[lane][rv] = value == 1;
+    }
+  }
+  // RV 5 = 0 & 1 cannot be 1 when RV 0 is 0
+  result[kLanes - 1] = {{0, false}, {5, true}};
+  return result;
+}
+
+}  // namespace
+
+int main() {
+  const std::filesystem::path dir = "batch_test_data";
+  const auto config = test_utils::writeDataset(dir, kFactors, kInputs, kBits, kSamples,
+                                               "[10, 11, 12]",
+                                               std::vector<uint8_t>(kSamples * kBits / 8, 0));
+  if (!check(config->valid(), "config is valid")) return 1;
+  const auto dataset = std::make_shared<hash_reversal::Dataset>(config);
+  const auto prob = std::make_shared<hash_reversal::Probability>(config);
+  const auto graph = hash_reversal::InferenceTool::loadGraph(*dataset, *config);
+  const std::vector<VariableAssignments> observed = observations();
+  bool ok = true;
+
+  // Serial reference of every lane
+  FactorGraph serial(prob, dataset, config, graph);
+  hash_reversal::InferenceTool &serial_tool = serial;
+  std::vector<std::vector<hash_reversal::InferenceTool::Prediction>> expected;
+  std::vector<size_t> expected_iterations;
+  for (const auto &lane : observed) {
+    serial_tool.reconfigure(lane);
+    serial.solve();
+    expected.push_back(serial.marginals());
+    expected_iterations.push_back(serial.iterations());
+  }
+
+  BatchFactorGraph batch(prob, dataset, config, graph);
+  for (const auto &kernels : hash_reversal::supportedBatchKernels()) {
+    batch.setKernels(kernels);
+    batch.reconfigure(observed);
+    batch.solve();
+    ok &= check(batch.numLanes() == kLanes, std::string(kernels.name) + ", number of lanes");
+
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      const std::string what = std::string(kernels.name) + ", lane " + std::to_string(lane);
+      const auto marginals = batch.marginals(lane);
+      bool same = marginals.size() == expected[lane].size();
+      for (size_t i = 0; same && i < marginals.size(); ++i) {
+        same = marginals[i].rv_index == expected[lane][i].rv_index &&
+               marginals[i].prob_one == expected[lane][i].prob_one;
+      }
+      ok &= check(same, what + ", marginals equal serial LBP");
+      ok &= check(batch.iterations()[lane] == expected_iterations[lane],
+                  what + ", iterations equal serial LBP");
+    }
+  }
+
+  std::filesystem::remove_all(dir);
+  if (ok) spdlog::info("All batch checks passed");
+  return ok ? 0 : 1;
+}
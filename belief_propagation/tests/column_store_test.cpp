@@ -0,0 +1,138 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+/*
+ * Checks the columns of `ColumnStore`, which are built with 64x64 bit matrix
+ * transposes, and their popcounts against the bits of `data.bits` read one at
+ * a time. Sample ranges start inside a block of 64 and end in a partial one,
+ * and samples are both used in place, realigned and streamed.
+ */
+
+#include <spdlog/spdlog.h>
+
+#include <filesystem>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hash_reversal/column_store.hpp"
+#include "hash_reversal/dataset.hpp"
+#include "test_utils.hpp"
+
+namespace {
+
+using hash_reversal::ColumnStore;
+using hash_reversal::Dataset;
+using test_utils::check;
+
+//! Bit `rv` of sample `sample` of the file, which packs samples MSB first
+bool fileBit(const std::vector<uint8_t> &data, size_t num_bits, size_t sample, size_t rv) {
+  const size_t bit = sample * num_bits + rv;
+  return (data[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+/*
+ * Builds the columns of `rvs` for every range and compares each bit and count
+ * with the file. `sample_offset` and `sample_stride` map the selected samples
+ * of the dataset to samples of the file.
+ */
+bool checkColumns(const Dataset &dataset, const std::vector<uint8_t> &data, size_t num_bits,
+                  size_t sample_offset, size_t sample_stride, const std::vector<size_t> &rvs,
+                  const std::string &name) {
+  bool ok = true;
+  const size_t n = dataset.numSamples();
+  const std::vector<std::pair<size_t, size_t>> ranges = {
+      {0, n}, {0, 64}, {5, 69}, {70, n}, {63, 65}, {n - 1, n}, {13, 13}};
+
+  for (const auto &range : ranges) {
+    const size_t begin = range.first, end = range.second;
+    const std::string what =
+        name + ", samples [" + std::to_string(begin) + ", " + std::to_string(end) + ")";
+    const ColumnStore columns(dataset, rvs, begin, end);
+    ok &= check(columns.numSamples() == end - begin && columns.numWords() == (end - begin + 63) / 64,
+                what + ": size");
+
+    for (size_t rv : rvs) {
+      const std::string rv_what = what + ", RV " + std::to_string(rv);
+      size_t ones = 0;
+      bool same = true;
+      for (size_t s = begin; s < end; ++s) {
+        const bool expected = fileBit(data, num_bits, sample_offset + s * sample_stride, rv);
+        same &= columns.value(rv, s - begin) == expected;
+        same &= dataset.getFullSample(s)[rv] == expected;
+        ones += expected;
+      }
+      ok &= check(same, rv_what + ": bits");
+      ok &= check(columns.countOnes(rv) == ones, rv_what + ": count of ones");
+
+      // The popcounts rely on the bits past the last sample being 0
+      if ((end - begin) % 64 != 0) {
+        const uint64_t last = columns.column(rv)[columns.numWords() - 1];
+        ok &= check((last >> ((end - begin) % 64)) == 0, rv_what + ": padding is 0");
+      }
+    }
+  }
+
+  // Only the requested RVs are loaded
+  const ColumnStore columns(dataset, {rvs[0]}, 0, n);
+  bool thrown = false;
+  try {
+    columns.column(rvs[1]);
+  } catch (const std::out_of_range &) {
+    thrown = true;
+  }
+  ok &= check(columns.contains(rvs[0]) && !columns.contains(rvs[1]) && thrown,
+              name + ": other RVs are not loaded");
+  return ok;
+}
+
+}  // namespace
+
+int main() {
+  const std::filesystem::path dir = "column_store_test_data";
+  const size_t num_samples = 200;
+  std::mt19937_64 rng(7);
+  bool ok = true;
+
+  // 128 bits per sample are used in place, 150 bits are realigned to words
+  for (size_t num_bits : {size_t(128), size_t(150)}) {
+    std::vector<uint8_t> data((num_bits * num_samples + 7) / 8);
+    for (auto &byte : data) byte = uint8_t(rng());
+
+    // Every RV of the first word, duplicates, and RVs of the other words
+    std::vector<size_t> rvs;
+    for (size_t rv = 0; rv < 64; ++rv) rvs.push_back(rv);
+    for (size_t rv : {size_t(3), size_t(64), num_bits - 1, size_t(100), size_t(65)}) {
+      rvs.push_back(rv);
+    }
+
+    const std::vector<std::map<std::string, std::string>> settings = {
+        {}, {{"dataset_streaming", "true"}}, {{"sample_offset", "3"}, {"sample_stride", "2"}}};
+    const std::vector<std::string> names = {"", ", streamed", ", offset 3 and stride 2"};
+    for (size_t i = 0; i < settings.size(); ++i) {
+      const std::string name = std::to_string(num_bits) + " bits" + names[i];
+      const auto config = test_utils::writeDataset(dir, "PRIOR;0\n", 1, num_bits, num_samples,
+                                                   "[1]", data, settings[i]);
+      if (!check(config->valid(), name + ": config is valid")) return 1;
+      const Dataset dataset(config);
+      ok &= checkColumns(dataset, data, num_bits, config->sample_offset, config->sample_stride,
+                         rvs, name);
+    }
+  }
+
+  std::filesystem::remove_all(dir);
+  if (ok) spdlog::info("All column store checks passed");
+  return ok ? 0 : 1;
+}
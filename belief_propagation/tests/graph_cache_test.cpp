@@ -0,0 +1,192 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+/*
+ * Checks the binary `factors.bin` cache of the factor graph: a saved graph
+ * loads back unchanged, and a cache for different text, with a damaged
+ * payload, cut short, missing or with a factor of the wrong size is rejected
+ * without touching the graph. Malformed lines of `factors.txt` are skipped.
+ */
+
+#include <spdlog/spdlog.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "hash_reversal/dataset.hpp"
+#include "hash_reversal/factor.hpp"
+#include "hash_reversal/topology.hpp"
+#include "test_utils.hpp"
+#include "utils/convenience.hpp"
+
+namespace {
+
+using hash_reversal::Dataset;
+using hash_reversal::Factor;
+using hash_reversal::Topology;
+using test_utils::check;
+
+//! True if every accessor of `a` and `b` returns the same
+bool sameGraph(const Topology &a, const Topology &b) {
+  if (a.numRVs() != b.numRVs() || a.numFactors() != b.numFactors() ||
+      a.numEdges() != b.numEdges() || a.numLevels() != b.numLevels()) {
+    return false;
+  }
+  for (size_t v = 0; v < a.numRVs(); ++v) {
+    if (a.rvIndex(v) != b.rvIndex(v) || b.denseRV(a.rvIndex(v)) != v ||
+        a.rvFactor(v) != b.rvFactor(v) || a.rvBegin(v) != b.rvBegin(v) ||
+        a.rvEnd(v) != b.rvEnd(v)) {
+      return false;
+    }
+  }
+  for (size_t f = 0; f < a.numFactors(); ++f) {
+    if (a.factorName(f) != b.factorName(f) || a.factorType(f) != b.factorType(f) ||
+        a.factorOutput(f) != b.factorOutput(f) || a.factorBegin(f) != b.factorBegin(f) ||
+        a.factorEnd(f) != b.factorEnd(f) || a.factorLevel(f) != b.factorLevel(f)) {
+      return false;
+    }
+  }
+  for (size_t e = 0; e < a.numEdges(); ++e) {
+    if (a.edgeRV(e) != b.edgeRV(e) || a.edgeFactor(e) != b.edgeFactor(e)) return false;
+  }
+  for (size_t l = 0; l < a.numLevels(); ++l) {
+    if (a.levelBegin(l) != b.levelBegin(l) || a.levelEnd(l) != b.levelEnd(l)) return false;
+  }
+  return a.rvEdges() == b.rvEdges() && a.levelFactors() == b.levelFactors();
+}
+
+std::string readFile(const std::filesystem::path &file) {
+  std::ifstream in(file, std::ios::in | std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::filesystem::path &file, const std::string &bytes) {
+  std::ofstream out(file, std::ios::out | std::ios::binary | std::ios::trunc);
+  out.write(bytes.data(), bytes.size());
+}
+
+}  // namespace
+
+int main() {
+  const std::filesystem::path dir = "graph_cache_test_data";
+  const std::filesystem::path text_file = dir / "factors.txt";
+  const std::filesystem::path cache_file = dir / "factors.bin";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  bool ok = true;
+
+  // The RV indices have gaps and the circuit has several levels
+  const std::string text = "PRIOR;0\nPRIOR;3\nPRIOR;5\nAND;2;0;3\nINV;7;2\nAND;9;5;7\n"
+                           "SAME;12;9\nAND;13;2;12\n";
+  writeFile(text_file, text);
+  const uint64_t checksum = utils::Convenience::checksum(text);
+
+  // The first load parses the text and writes the cache, the second reads it
+  const Topology parsed = Dataset::loadFactorGraph(text_file.string());
+  ok &= check(std::filesystem::exists(cache_file), "the first load writes factors.bin");
+  ok &= check(parsed.numFactors() == 8 && parsed.numRVs() == 8 && parsed.numLevels() == 6,
+              "the text is parsed into the circuit");
+  ok &= check(sameGraph(Dataset::loadFactorGraph(text_file.string()), parsed),
+              "the cached graph is the parsed one");
+
+  Topology loaded;
+  ok &= check(loaded.load(cache_file.string(), checksum), "factors.bin loads");
+  ok &= check(sameGraph(loaded, parsed), "factors.bin round trips every array");
+
+  const std::filesystem::path copy_file = dir / "copy.bin";
+  ok &= check(loaded.save(copy_file.string(), checksum), "a loaded graph saves again");
+  ok &= check(readFile(copy_file) == readFile(cache_file), "saving is deterministic");
+
+  const Topology empty;
+  ok &= check(empty.save((dir / "empty.bin").string(), 0), "the empty graph saves");
+  Topology empty_loaded;
+  ok &= check(empty_loaded.load((dir / "empty.bin").string(), 0) && sameGraph(empty_loaded, empty),
+              "the empty graph round trips");
+
+  // Every rejected file must leave the graph that was there before
+  const std::string bytes = readFile(cache_file);
+  const std::filesystem::path bad_file = dir / "bad.bin";
+  auto rejected = [&](const std::string &what) {
+    Topology graph;
+    graph.load(copy_file.string(), checksum);
+    const bool failed = !graph.load(bad_file.string(), checksum);
+    ok &= check(failed && sameGraph(graph, parsed), what + " is rejected");
+  };
+
+  writeFile(bad_file, bytes);
+  Topology graph;
+  graph.load(cache_file.string(), checksum);
+  ok &= check(!graph.load(bad_file.string(), checksum + 1) && sameGraph(graph, parsed),
+              "a cache of different text is rejected");
+
+  std::string bad = bytes;
+  bad[0] ^= 1;
+  writeFile(bad_file, bad);
+  rejected("a wrong magic number");
+
+  // Header: 8-byte magic, source checksum, payload checksum
+  const size_t header_size = 24;
+  bad = bytes;
+  bad[8] ^= 1;
+  writeFile(bad_file, bad);
+  rejected("a damaged source checksum");
+
+  for (size_t i = header_size; i < bytes.size(); i += 7) {
+    bad = bytes;
+    bad[i] ^= 0x10;
+    writeFile(bad_file, bad);
+    rejected("a damaged payload byte " + std::to_string(i));
+  }
+
+  for (size_t size : {size_t(0), size_t(5), header_size - 1, header_size, header_size + 3,
+                      bytes.size() / 2, bytes.size() - 1}) {
+    writeFile(bad_file, bytes.substr(0, size));
+    rejected("a file cut to " + std::to_string(size) + " bytes");
+  }
+
+  writeFile(bad_file, bytes + std::string(8, '\0'));
+  rejected("trailing bytes");
+
+  std::filesystem::remove(bad_file);
+  rejected("a missing file");
+
+  // A stale cache is replaced once the text changes
+  const std::string changed = text + "INV;14;13\n";
+  writeFile(text_file, changed);
+  const Topology reparsed = Dataset::loadFactorGraph(text_file.string());
+  ok &= check(reparsed.numFactors() == 9 && readFile(cache_file) != bytes,
+              "a changed factors.txt is parsed and cached again");
+  ok &= check(graph.load(cache_file.string(), utils::Convenience::checksum(changed)) &&
+                  sameGraph(graph, reparsed),
+              "the new cache matches the new text");
+
+  // Lines with the wrong number of RVs for their type, an output which is
+  // also an input or an unknown type are skipped, and the rest is kept
+  const std::string malformed = text + "AND;20;0;2;3;5\nINV;21;2;3\nPRIOR;22;0\nSAME;23\n"
+                                       "AND;24;0\nINV;25;25\nAND;26;26;0\nXOR;27;0;3\n";
+  writeFile(text_file, malformed);
+  ok &= check(sameGraph(Dataset::loadFactorGraph(text_file.string()), parsed),
+              "malformed and unsupported factors are skipped");
+
+  // A cache whose factor has more edges than its type is rejected as well
+  std::map<size_t, Factor> wide = {{4, Factor("AND", 4, {0, 1, 2, 3, 4})}};
+  ok &= check(Topology(wide).save(bad_file.string(), checksum), "a wide factor saves");
+  rejected("a factor with more edges than its type");
+
+  std::filesystem::remove_all(dir);
+  if (ok) spdlog::info("All graph cache checks passed");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+/*
+ * Checks the closed-form factor message kernels of `Probability` against the
+ * enumeration of all assignments they replaced, for every factor type and
+ * every combination of observed RVs, in the probability and the log domain.
+ */
+
+#include <spdlog/spdlog.h>
+
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hash_reversal/factor.hpp"
+#include "hash_reversal/probability.hpp"
+#include "test_utils.hpp"
+
+namespace {
+
+using hash_reversal::FactorType;
+using hash_reversal::Message;
+using hash_reversal::Observation;
+using hash_reversal::Probability;
+using test_utils::check;
+
+/*
+ * Message from a factor with `n` RVs (output first) to its RV `to`, by summing
+ * over all assignments of the other RVs. Observed RVs only take their observed
+ * value, the same as the old per-edge enumeration in `FactorGraph`.
+ */
+Message enumerate(const Probability &prob, FactorType type, const Observation *obs,
+                  const Message *in, size_t n, size_t to) {
+  Message result = {0.0, 0.0};
+  for (size_t combo = 0; combo < (1u << n); ++combo) {
+    bool values[3] = {false, false, false};
+    double product = 1.0;
+    for (size_t i = 0; i < n; ++i) {
+      values[i] = (combo >> i) & 1;
+      if (i == to) continue;
+      if (obs[i] != hash_reversal::UNOBSERVED && values[i] != (obs[i] == hash_reversal::OBSERVED_ONE)) {
+        product = 0.0;
+      }
+      product *= in[i][values[i]];
+    }
+    result[values[to]] += product * prob.probOne(type, obs[0], values[0], values[1], values[2]);
+  }
+  return result;
+}
+
+bool close(double a, double b) { return std::abs(a - b) <= 1e-12 * std::max(1.0, std::abs(b)); }
+
+}  // namespace
+
+int main() {
+  const std::filesystem::path dir = "probability_test_data";
+  const auto config = test_utils::writeDataset(dir, "PRIOR;0\n", 1, 8, 8, "[0]",
+                                               std::vector<uint8_t>(8, 0));
+  if (!check(config->valid(), "config is valid")) return 1;
+  const Probability prob(config);
+
+  const std::vector<std::pair<FactorType, size_t>> types = {
+      {FactorType::PRIOR, 1}, {FactorType::INV, 2}, {FactorType::SAME, 2}, {FactorType::AND, 3}};
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<double> uniform(0.01, 1.0);
+  bool ok = true;
+
+  for (const auto &itr : types) {
+    const FactorType type = itr.first;
+    const size_t n = itr.second;
+    size_t num_obs_combos = 1;
+    for (size_t i = 0; i < n; ++i) num_obs_combos *= 3;
+
+    for (size_t obs_combo = 0; obs_combo < num_obs_combos; ++obs_combo) {
+      Observation obs[3];
+      for (size_t i = 0, c = obs_combo; i < n; ++i, c /= 3) obs[i] = Observation(c % 3);
+
+      for (size_t trial = 0; trial < 20; ++trial) {
+        const std::string what = "type " + std::to_string(size_t(type)) + ", observations " +
+                                 std::to_string(obs_combo) + ", trial " + std::to_string(trial);
+        Message in[3], masked[3], out[3];
+        double llrs[3], out_llrs[3];
+        for (size_t i = 0; i < n; ++i) {
+          in[i] = {uniform(rng), uniform(rng)};
+          masked[i] = {obs[i] == hash_reversal::OBSERVED_ONE ? 0.0 : in[i][0],
+                       obs[i] == hash_reversal::OBSERVED_ZERO ? 0.0 : in[i][1]};
+          llrs[i] = std::log(in[i][1]) - std::log(in[i][0]);
+        }
+
+        prob.factorMessages(type, obs[0], masked, out);
+        prob.factorLLRs(type, obs[0], obs, llrs, out_llrs, n);
+
+        for (size_t to = 0; to < n; ++to) {
+          const Message expected = enumerate(prob, type, obs, in, n, to);
+          ok &= check(close(out[to][0], expected[0]) && close(out[to][1], expected[1]),
+                      what + ", message to RV " + std::to_string(to));
+
+          // The log-domain kernel normalizes its inputs, which scales both
+          // entries of a message alike and leaves the ratio unchanged
+          const double expected_llr = std::log(expected[1]) - std::log(expected[0]);
+          ok &= check(std::abs(out_llrs[to] - expected_llr) <= 1e-9,
+                      what + ", LLR to RV " + std::to_string(to));
+        }
+      }
+    }
+  }
+
+  std::filesystem::remove_all(dir);
+  if (ok) spdlog::info("All probability checks passed");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+/*
+ * Checks that `profile.json` and `trace.json` written by the `Profiler` are
+ * valid JSON, also when a distribution gets infinite or NaN values, and that
+ * they read back as the phases, counters and values that were recorded. The
+ * parser is strict: unlike e.g. Python's `json` module, it rejects `inf`,
+ * `nan`, `Infinity` and `NaN`.
+ */
+
+#include <spdlog/spdlog.h>
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_utils.hpp"
+#include "utils/profiler.hpp"
+
+namespace {
+
+using test_utils::check;
+
+struct Json {
+  enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT } type = NUL;
+  bool boolean = false;
+  double number = 0.0;
+  std::string string;
+  std::vector<Json> array;
+  std::map<std::string, Json> object;
+
+  //! Member `key` of an object, or null
+  const Json &operator[](const std::string &key) const {
+    static const Json null;
+    const auto itr = object.find(key);
+    return itr == object.end() ? null : itr->second;
+  }
+};
+
+//! Recursive descent parser of RFC 8259 JSON, without unicode escapes
+class Parser {
+ public:
+  explicit Parser(const std::string &text) : text_(text), pos_(0) {}
+
+  //! Parses the whole text, returns false if it is not exactly one JSON value
+  bool parse(Json &result) {
+    if (!value(result)) return false;
+    skipSpace();
+    return pos_ == text_.size();
+  }
+
+ private:
+  void skipSpace() {
+    while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+  }
+
+  bool literal(const std::string &word) {
+    if (text_.compare(pos_, word.size(), word) != 0) return false;
+    pos_ += word.size();
+    return true;
+  }
+
+  bool value(Json &result) {
+    skipSpace();
+    if (pos_ >= text_.size()) return false;
+    const char c = text_[pos_];
+    if (c == '{') return object(result);
+    if (c == '[') return array(result);
+    if (c == '"') {
+      result.type = Json::STRING;
+      return string(result.string);
+    }
+    if (literal("null")) {
+      result.type = Json::NUL;
+      return true;
+    }
+    if (literal("true") || literal("false")) {
+      result.type = Json::BOOLEAN;
+      result.boolean = text_[pos_ - 1] == 'e' && text_[pos_ - 2] == 'u';
+      return true;
+    }
+    return number(result);
+  }
+
+  bool object(Json &result) {
+    result.type = Json::OBJECT;
+    ++pos_;
+    skipSpace();
+    if (pos_ < text_.size() && text_[pos_] == '}') return ++pos_, true;
+    while (true) {
+      std::string key;
+      skipSpace();
+      if (pos_ >= text_.size() || text_[pos_] != '"' || !string(key)) return false;
+      skipSpace();
+      if (pos_ >= text_.size() || text_[pos_++] != ':') return false;
+      if (!value(result.object[key])) return false;
+      skipSpace();
+      if (pos_ >= text_.size()) return false;
+      const char c = text_[pos_++];
+      if (c == '}') return true;
+      if (c != ',') return false;
+    }
+  }
+
+  bool array(Json &result) {
+    result.type = Json::ARRAY;
+    ++pos_;
+    skipSpace();
+    if (pos_ < text_.size() && text_[pos_] == ']') return ++pos_, true;
+    while (true) {
+      result.array.emplace_back();
+      if (!value(result.array.back())) return false;
+      skipSpace();
+      if (pos_ >= text_.size()) return false;
+      const char c = text_[pos_++];
+      if (c == ']') return true;
+      if (c != ',') return false;
+    }
+  }
+
+  bool string(std::string &result) {
+    ++pos_;
+    while (pos_ < text_.size() && text_[pos_] != '"') {
+      if (static_cast<unsigned char>(text_[pos_]) < 0x20) return false;
+      if (text_[pos_] == '\\') {
+        const std::string escapes = "\"\\/bfnrt";
+        if (++pos_ >= text_.size() || escapes.find(text_[pos_]) == std::string::npos) return false;
+      }
+      result += text_[pos_++];
+    }
+    return pos_++ < text_.size();
+  }
+
+  //! -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+  bool number(Json &result) {
+    const size_t start = pos_;
+    const auto digits = [&]() {
+      const size_t first = pos_;
+      while (pos_ < text_.size() && std::isdigit(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+      return pos_ > first;
+    };
+    if (pos_ < text_.size() && text_[pos_] == '-') ++pos_;
+    if (pos_ < text_.size() && text_[pos_] == '0') {
+      ++pos_;
+    } else if (!digits()) {
+      return false;
+    }
+    if (pos_ < text_.size() && text_[pos_] == '.') {
+      ++pos_;
+      if (!digits()) return false;
+    }
+    if (pos_ < text_.size() && (text_[pos_] == 'e' || text_[pos_] == 'E')) {
+      ++pos_;
+      if (pos_ < text_.size() && (text_[pos_] == '+' || text_[pos_] == '-')) ++pos_;
+      if (!digits()) return false;
+    }
+    result.type = Json::NUMBER;
+    result.number = std::strtod(text_.substr(start, pos_ - start).c_str(), nullptr);
+    return true;
+  }
+
+  const std::string &text_;
+  size_t pos_;
+};
+
+bool parseFile(const std::filesystem::path &file, Json &result) {
+  std::ifstream in(file);
+  const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  return Parser(text).parse(result);
+}
+
+bool isNumber(const Json &json, double expected) {
+  return json.type == Json::NUMBER && std::abs(json.number - expected) <= 1e-6;
+}
+
+}  // namespace
+
+int main() {
+  const std::filesystem::path dir = "profiler_test_data";
+  std::filesystem::create_directories(dir);
+  bool ok = true;
+
+  // The parser itself must reject what an unguarded writer produced
+  Json rejected;
+  for (const std::string text : {"{\"x\": inf}", "{\"x\": nan}", "{\"x\": -inf}", "[Infinity]",
+                                 "[NaN]", "[1,]", "{\"x\": 1", "[01]", "[1.]", "[.5]"}) {
+    ok &= check(!Parser(text).parse(rejected), "the parser rejects " + text);
+  }
+
+  // The profiler is used directly, so the test does not need the build flag
+  utils::Profiler &profiler = utils::Profiler::instance();
+  const double inf = std::numeric_limits<double>::infinity();
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  profiler.value("residual", inf);
+  profiler.value("residual", 0.5);
+  profiler.value("residual", 0.25);
+  profiler.value("residual", nan);
+  profiler.value("only_inf", inf);
+  profiler.value("huge", std::numeric_limits<double>::max());
+  profiler.value("huge", std::numeric_limits<double>::max());
+  profiler.count("messages", 3);
+  { const utils::Profiler::Scope scope("phase"); }
+
+  // Another thread, whose buffers are merged into the same names
+  std::thread thread([&profiler, inf]() {
+    profiler.value("residual", -inf);
+    profiler.value("residual", 2.0);
+    profiler.count("messages", 4);
+    const utils::Profiler::Scope scope("phase");
+  });
+  thread.join();
+
+  profiler.save((dir / "profile.json").string(), (dir / "trace.json").string());
+
+  Json summary, trace;
+  ok &= check(parseFile(dir / "profile.json", summary) && summary.type == Json::OBJECT,
+              "profile.json is valid JSON");
+  ok &= check(parseFile(dir / "trace.json", trace) && trace.type == Json::OBJECT,
+              "trace.json is valid JSON");
+
+  const Json &residual = summary["values"]["residual"];
+  ok &= check(isNumber(residual["count"], 3) && isNumber(residual["non_finite"], 3),
+              "finite and non-finite residuals are counted apart");
+  ok &= check(isNumber(residual["total"], 2.75) && isNumber(residual["mean"], 2.75 / 3) &&
+                  isNumber(residual["min"], 0.25) && isNumber(residual["max"], 2.0),
+              "the residual distribution only has the finite values");
+
+  const Json &only_inf = summary["values"]["only_inf"];
+  ok &= check(isNumber(only_inf["count"], 0) && isNumber(only_inf["non_finite"], 1) &&
+                  isNumber(only_inf["mean"], 0.0),
+              "a distribution of only infinite values is empty");
+
+  const Json &huge = summary["values"]["huge"];
+  ok &= check(isNumber(huge["count"], 2) && huge["total"].type == Json::NUL &&
+                  huge["mean"].type == Json::NUL && huge["max"].type == Json::NUMBER,
+              "a total which overflows is null");
+
+  ok &= check(isNumber(summary["counters"]["messages"], 7), "counters of both threads are merged");
+  ok &= check(isNumber(summary["phases"]["phase"]["count"], 2) &&
+                  isNumber(summary["phases"]["phase"]["non_finite"], 0),
+              "phases of both threads are merged");
+
+  const Json &events = trace["traceEvents"];
+  ok &= check(events.type == Json::ARRAY && events.array.size() == 2, "both phases are traced");
+  for (const Json &event : events.array) {
+    ok &= check(event["name"].string == "phase" && event["ph"].string == "X" &&
+                    event["ts"].type == Json::NUMBER && event["dur"].type == Json::NUMBER,
+                "trace event fields");
+  }
+
+  std::filesystem::remove_all(dir);
+  if (ok) spdlog::info("All profiler checks passed");
+  return ok ? 0 : 1;
+}
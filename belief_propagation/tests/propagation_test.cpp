@@ -0,0 +1,114 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+/*
+ * Checks the unit propagation of `InferenceTool::propagateObserved` on a small
+ * circuit: every forward and backward implication of AND, INV and SAME, the
+ * fixpoint over several factors, and that contradictory observations are
+ * counted as conflicts without overwriting what was observed.
+ */
+
+#include <spdlog/spdlog.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+#include "hash_reversal/factor.hpp"
+#include "hash_reversal/inference_tool.hpp"
+#include "hash_reversal/topology.hpp"
+#include "test_utils.hpp"
+
+namespace {
+
+using hash_reversal::Factor;
+using hash_reversal::InferenceTool;
+using hash_reversal::Topology;
+using hash_reversal::VariableAssignments;
+using test_utils::check;
+
+void addFactor(std::map<size_t, Factor> &factors, const std::string &type, size_t out,
+               const std::set<size_t> &inputs) {
+  std::set<size_t> ref = inputs;
+  ref.insert(out);
+  factors[out] = Factor(type, out, ref);
+}
+
+/*
+ * RVs 0-3 are the input, RV 4 = 0 & 1, RV 5 = ~4, RV 6 = 2, RV 7 = 6 & 3 and
+ * RV 8 = 4 & 7.
+ */
+std::shared_ptr<const Topology> circuit() {
+  std::map<size_t, Factor> factors;
+  for (size_t rv = 0; rv < 4; ++rv) addFactor(factors, "PRIOR", rv, {});
+  addFactor(factors, "AND", 4, {0, 1});
+  addFactor(factors, "INV", 5, {4});
+  addFactor(factors, "SAME", 6, {2});
+  addFactor(factors, "AND", 7, {6, 3});
+  addFactor(factors, "AND", 8, {4, 7});
+  return std::make_shared<const Topology>(factors);
+}
+
+//! Propagates `observed` and checks the result is `expected`, without conflicts
+bool checkPropagation(const InferenceTool &tool, const VariableAssignments &observed,
+                      const VariableAssignments &expected, const std::string &what) {
+  size_t num_conflicts = 0;
+  const VariableAssignments result = tool.propagateObserved(observed, &num_conflicts);
+  return check(result == expected, what) && check(num_conflicts == 0, what + ", no conflicts");
+}
+
+}  // namespace
+
+int main() {
+  // Propagation only reads the graph
+  const InferenceTool tool(nullptr, nullptr, nullptr, circuit());
+  bool ok = true;
+
+  ok &= checkPropagation(tool, {{8, true}},
+                         {{0, true}, {1, true}, {2, true}, {3, true}, {4, true}, {5, false},
+                          {6, true}, {7, true}, {8, true}},
+                         "AND output 1 forces both inputs to 1, down to the inputs");
+  ok &= checkPropagation(tool, {{0, true}, {1, true}},
+                         {{0, true}, {1, true}, {4, true}, {5, false}},
+                         "AND inputs 1 and 1 force the output to 1, then INV forward");
+  ok &= checkPropagation(tool, {{3, false}}, {{3, false}, {7, false}, {8, false}},
+                         "an AND input 0 forces the output to 0, over two factors");
+  ok &= checkPropagation(tool, {{5, true}, {0, true}},
+                         {{0, true}, {1, false}, {4, false}, {5, true}, {8, false}},
+                         "INV backward, then AND output 0 with an input 1 forces the other to 0");
+  ok &= checkPropagation(tool, {{7, false}, {6, true}},
+                         {{2, true}, {3, false}, {6, true}, {7, false}, {8, false}},
+                         "AND output 0 with an input 1 forces the other to 0, SAME backward");
+  ok &= checkPropagation(tool, {{2, false}}, {{2, false}, {6, false}, {7, false}, {8, false}},
+                         "SAME forward");
+  ok &= checkPropagation(tool, {{4, false}}, {{4, false}, {5, true}, {8, false}},
+                         "AND output 0 alone does not force its inputs");
+  ok &= checkPropagation(tool, {{1, true}, {100, true}}, {{1, true}, {100, true}},
+                         "observed RVs outside the graph are kept and imply nothing");
+
+  // RV 8 = 1 implies RV 0 = 1, which was observed as 0
+  size_t num_conflicts = 0;
+  VariableAssignments result = tool.propagateObserved({{0, false}, {8, true}}, &num_conflicts);
+  ok &= check(num_conflicts > 0, "an observation against an implied value is a conflict");
+  ok &= check(result.at(0) == false && result.at(8) == true, "observed values are not overwritten");
+
+  // RV 5 = 1 implies RV 4 = 0, RV 8 = 1 implies RV 4 = 1
+  num_conflicts = 0;
+  result = tool.propagateObserved({{5, true}, {8, true}}, &num_conflicts);
+  ok &= check(num_conflicts > 0, "two observations implying different values are a conflict");
+  ok &= check(result.at(5) == true && result.at(8) == true,
+              "conflicting observations are both kept");
+
+  if (ok) spdlog::info("All propagation checks passed");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#pragma once
+
+#include <spdlog/spdlog.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "utils/config.hpp"
+
+namespace test_utils {
+
+//! Logs `what` if the check failed, returns `ok`
+inline bool check(bool ok, const std::string &what) {
+  if (!ok) spdlog::error("FAILED: {}", what);
+  return ok;
+}
+
+/*
+ * Writes a dataset to `dir`: `factors` as factors.txt, `data` as data.bits
+ * and params.yaml from the other arguments. Returns the config of a run on
+ * it, with the default settings of a single-threaded serial LBP run except
+ * for the keys in `overrides`.
+ */
+inline std::shared_ptr<utils::Config> writeDataset(
+    const std::filesystem::path &dir, const std::string &factors, size_t num_input_bits,
+    size_t num_bits, size_t num_samples, const std::string &observed,
+    const std::vector<uint8_t> &data, const std::map<std::string, std::string> &overrides = {}) {
+  std::filesystem::create_directories(dir);
+
+  std::ofstream factors_file(dir / "factors.txt");
+  factors_file << factors;
+  factors_file.close();
+
+  std::ofstream params(dir / "params.yaml");
+  params << "hash: test\nnum_input_bits: " << num_input_bits
+         << "\nnum_bits_per_sample: " << num_bits << "\nnum_samples: " << num_samples
+         << "\ndifficulty: 1\nobserved_rv_indices: " << observed << "\n";
+  params.close();
+
+  std::ofstream data_file(dir / "data.bits", std::ios::out | std::ios::binary);
+  data_file.write(reinterpret_cast<const char *>(data.data()), data.size());
+  data_file.close();
+
+  std::map<std::string, std::string> settings = {
+      {"lbp_max_iter", "50"},          {"lbp_damping", "0.75"},
+      {"lbp_schedule", "\"serial\""},  {"lbp_quantization", "\"none\""},
+      {"lbp_compaction", "false"},     {"lbp_warm_start", "\"cold\""},
+      {"num_threads", "1"},            {"batch_size", "8"},
+      {"num_workers", "1"},            {"dataset_streaming", "false"},
+      {"sample_offset", "0"},          {"sample_stride", "1"},
+      {"epsilon", "0.0001"},           {"num_test", "1"},
+      {"print_connections", "false"},  {"test_mode", "false"},
+      {"method", "\"lbp\""}};
+  settings["dataset_dir"] = "\"" + std::filesystem::absolute(dir).string() + "\"";
+  for (const auto &itr : overrides) settings[itr.first] = itr.second;
+
+  const std::filesystem::path config_file = dir / "test.yaml";
+  std::ofstream config(config_file);
+  for (const auto &itr : settings) config << itr.first << ": " << itr.second << "\n";
+  config.close();
+
+  return std::make_shared<utils::Config>(config_file.string());
+}
+
+}  // namespace test_utils
@@ -0,0 +1,186 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+/*
+ * Checks the CSR `Topology` of a small circuit against the `std::map` of
+ * factors it is built from: dense IDs, the edges of every factor and RV, the
+ * topological levels, and the subgraph of some of the factors.
+ */
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "hash_reversal/factor.hpp"
+#include "hash_reversal/topology.hpp"
+#include "test_utils.hpp"
+
+namespace {
+
+using hash_reversal::Factor;
+using hash_reversal::Topology;
+using test_utils::check;
+
+void addFactor(std::map<size_t, Factor> &factors, const std::string &type, size_t out,
+               const std::set<size_t> &inputs) {
+  std::set<size_t> ref = inputs;
+  ref.insert(out);
+  factors[out] = Factor(type, out, ref);
+}
+
+/*
+ * RV indices have gaps and an input (RV 3) has a higher index than the output
+ * of a factor that reads it (RV 2), so neither the dense IDs nor the edge
+ * order can be taken from the original indices as they are.
+ */
+std::map<size_t, Factor> circuit() {
+  std::map<size_t, Factor> factors;
+  addFactor(factors, "PRIOR", 0, {});
+  addFactor(factors, "PRIOR", 3, {});
+  addFactor(factors, "PRIOR", 5, {});
+  addFactor(factors, "AND", 2, {0, 3});
+  addFactor(factors, "INV", 7, {2});
+  addFactor(factors, "AND", 9, {5, 7});
+  addFactor(factors, "SAME", 12, {9});
+  addFactor(factors, "AND", 13, {2, 12});
+  return factors;
+}
+
+//! Checks every array of `graph` against the factors it was built from
+bool checkGraph(const Topology &graph, const std::map<size_t, Factor> &factors,
+                const std::string &name) {
+  bool ok = true;
+
+  std::set<size_t> rvs;
+  for (const auto &itr : factors) {
+    rvs.insert(itr.second.referenced_rvs.begin(), itr.second.referenced_rvs.end());
+  }
+  ok &= check(graph.numRVs() == rvs.size(), name + ": number of RVs");
+  ok &= check(graph.numFactors() == factors.size(), name + ": number of factors");
+
+  size_t v = 0;
+  for (size_t rv : rvs) {
+    ok &= check(graph.rvIndex(v) == rv && graph.denseRV(rv) == v,
+                name + ": dense ID of RV " + std::to_string(rv));
+    ++v;
+  }
+  for (size_t rv = 0; rv < 20; ++rv) {
+    if (rvs.count(rv) == 0) {
+      ok &= check(graph.denseRV(rv) == Topology::npos, name + ": RV " + std::to_string(rv) +
+                                                           " is not in the graph");
+    }
+  }
+
+  // Factors are in order of their output RV, with the output on the first edge
+  size_t f = 0, num_edges = 0;
+  for (const auto &itr : factors) {
+    const Factor &factor = itr.second;
+    const std::string what = name + ": factor " + std::to_string(f);
+    ok &= check(graph.factorType(f) == factor.type && graph.factorName(f) == factor.factor_type,
+                what + " type");
+    ok &= check(graph.rvIndex(graph.factorOutput(f)) == factor.output_rv, what + " output");
+    ok &= check(graph.rvFactor(graph.factorOutput(f)) == f, what + " is the factor of its output");
+    ok &= check(graph.factorBegin(f) == num_edges, what + " edges are contiguous");
+
+    std::vector<size_t> expected = {factor.output_rv};
+    for (size_t rv : factor.inputRVs()) expected.push_back(rv);
+    std::vector<size_t> actual;
+    for (size_t e = graph.factorBegin(f); e < graph.factorEnd(f); ++e) {
+      actual.push_back(graph.rvIndex(graph.edgeRV(e)));
+      ok &= check(graph.edgeFactor(e) == f, what + " edge points back to the factor");
+    }
+    ok &= check(actual == expected, what + " edges are the output and then the inputs");
+
+    const Factor rebuilt = graph.factor(f);
+    ok &= check(rebuilt.output_rv == factor.output_rv &&
+                    rebuilt.referenced_rvs == factor.referenced_rvs && rebuilt.type == factor.type,
+                what + " converts back to a Factor");
+
+    num_edges += expected.size();
+    ++f;
+  }
+  ok &= check(graph.numEdges() == num_edges, name + ": number of edges");
+
+  // Every edge is listed exactly once, under its own RV, in increasing order
+  std::vector<size_t> seen(graph.numEdges(), 0);
+  for (v = 0; v < graph.numRVs(); ++v) {
+    size_t previous = Topology::npos;
+    for (size_t i = graph.rvBegin(v); i < graph.rvEnd(v); ++i) {
+      const size_t e = graph.rvEdges()[i];
+      ok &= check(graph.edgeRV(e) == v, name + ": RV edge belongs to the RV");
+      ok &= check(previous == Topology::npos || e > previous, name + ": RV edges are sorted");
+      previous = e;
+      ++seen[e];
+    }
+    if (graph.rvFactor(v) == Topology::npos) {
+      const size_t rv = graph.rvIndex(v);
+      ok &= check(factors.count(rv) == 0, name + ": RV " + std::to_string(rv) + " has a factor");
+    }
+  }
+  for (size_t e = 0; e < graph.numEdges(); ++e) {
+    ok &= check(seen[e] == 1, name + ": edge " + std::to_string(e) + " is listed once");
+  }
+
+  // A factor is one level above the highest factor computing one of its inputs
+  for (f = 0; f < graph.numFactors(); ++f) {
+    size_t level = 0;
+    for (size_t e = graph.factorBegin(f) + 1; e < graph.factorEnd(f); ++e) {
+      const size_t parent = graph.rvFactor(graph.edgeRV(e));
+      if (parent != Topology::npos) level = std::max(level, graph.factorLevel(parent) + 1);
+    }
+    ok &= check(graph.factorLevel(f) == level, name + ": level of factor " + std::to_string(f));
+  }
+  for (size_t l = 0; l < graph.numLevels(); ++l) {
+    for (size_t i = graph.levelBegin(l); i < graph.levelEnd(l); ++i) {
+      ok &= check(graph.factorLevel(graph.levelFactors()[i]) == l,
+                  name + ": factor listed under its level");
+    }
+  }
+  ok &= check(graph.levelEnd(graph.numLevels() - 1) == graph.numFactors(),
+              name + ": every factor has a level");
+  return ok;
+}
+
+}  // namespace
+
+int main() {
+  bool ok = true;
+
+  const auto factors = circuit();
+  const Topology graph(factors);
+  ok &= checkGraph(graph, factors, "full graph");
+  ok &= check(graph.numLevels() == 6, "full graph: PRIOR, AND, INV, AND, SAME, AND levels");
+
+  // Dropping the PRIORs and the last AND leaves a subgraph which must be the
+  // same as one built from the remaining factors
+  std::vector<uint8_t> keep(graph.numFactors(), 0);
+  std::map<size_t, Factor> kept;
+  for (size_t f = 0; f < graph.numFactors(); ++f) {
+    const Factor factor = graph.factor(f);
+    if (factor.type == hash_reversal::FactorType::PRIOR || factor.output_rv == 13) continue;
+    keep[f] = 1;
+    kept[factor.output_rv] = factor;
+  }
+  ok &= checkGraph(Topology(graph, keep), kept, "subgraph");
+
+  const Topology empty;
+  ok &= check(empty.numRVs() == 0 && empty.numFactors() == 0 && empty.numEdges() == 0 &&
+                  empty.numLevels() == 0,
+              "empty graph");
+
+  if (ok) spdlog::info("All topology checks passed");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+/*
+ * Hash reversal
+ *
+ * Copyright (c) 2020 Authors:
+ *   - Trevor Phillips <trevphil3@gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+/*
+ * Checks `Dataset::validate` on a small circuit: the true input of a sample is
+ * accepted, a wrong input is rejected, an observed bit which is not in the
+ * factor graph is ignored, and a PRIOR which is not a hash input bit makes
+ * the graph unfit for validation.
+ */
+
+#include <spdlog/spdlog.h>
+
+#include <boost/dynamic_bitset.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hash_reversal/circuit_simulator.hpp"
+#include "hash_reversal/dataset.hpp"
+#include "hash_reversal/topology.hpp"
+#include "test_utils.hpp"
+#include "utils/config.hpp"
+
+namespace {
+
+using test_utils::check;
+
+constexpr size_t kInputs = 4, kBits = 8, kSamples = 8;
+
+/*
+ * RVs 0-3 are the input, RV 4 = 0 & 1, RV 5 = ~4 and RV 6 = 2 & 3. RV 7 is
+ * observed but has no factor, as if it had been pruned. Every sample has the
+ * input 1101 (RVs 0-3), so RVs 4-7 are 1, 0, 0 and 1. With `extra_prior`, RV 6
+ * is a PRIOR instead of an AND.
+ */
+std::shared_ptr<utils::Config> writeDataset(const std::filesystem::path &dir, bool extra_prior) {
+  std::string factors;
+  for (size_t rv = 0; rv < kInputs; ++rv) factors += "PRIOR;" + std::to_string(rv) + "\n";
+  factors += std::string("AND;4;0;1\nINV;5;4\n") + (extra_prior ? "PRIOR;6\n" : "AND;6;2;3\n");
+
+  const std::vector<uint8_t> bytes(kSamples * kBits / 8, 0xd9);  // 1101 1001
+  return test_utils::writeDataset(dir, factors, kInputs, kBits, kSamples, "[5, 6, 7]", bytes);
+}
+
+boost::dynamic_bitset<> input(const std::string &bits) {
+  boost::dynamic_bitset<> result(bits.size());
+  for (size_t i = 0; i < bits.size(); ++i) result[i] = bits[i] == '1';
+  return result;
+}
+
+}  // namespace
+
+int main() {
+  const std::filesystem::path dir = "validate_test_data";
+  bool ok = true;
+
+  {
+    const auto config = writeDataset(dir / "circuit", false);
+    if (!check(config->valid(), "config is valid")) return 1;
+    const hash_reversal::Dataset dataset(config);
+    const auto graph = std::make_shared<const hash_reversal::Topology>(
+        hash_reversal::Dataset::loadFactorGraph((dir / "circuit" / "factors.txt").string()));
+    const hash_reversal::CircuitSimulator simulator(graph);
+
+    ok &= check(dataset.canValidate(simulator), "inputs are the hash input bits");
+    ok &= check(dataset.validate(simulator, input("1101"), 0), "true input is accepted");
+    ok &= check(!dataset.validate(simulator, input("0101"), 0), "RV 5 differs, rejected");
+    ok &= check(!dataset.validate(simulator, input("1111"), 0), "RV 6 differs, rejected");
+  }
+
+  {
+    const auto config = writeDataset(dir / "extra_prior", true);
+    if (!check(config->valid(), "config is valid")) return 1;
+    const hash_reversal::Dataset dataset(config);
+    const auto graph = std::make_shared<const hash_reversal::Topology>(
+        hash_reversal::Dataset::loadFactorGraph((dir / "extra_prior" / "factors.txt").string()));
+    const hash_reversal::CircuitSimulator simulator(graph);
+
+    ok &= check(!dataset.canValidate(simulator), "PRIOR on RV 6 is not a hash input bit");
+    ok &= check(!dataset.validate(simulator, input("1101"), 0),
+                "RV 6 is not taken from the sample");
+  }
+
+  std::filesystem::remove_all(dir);
+  if (ok) spdlog::info("All validation checks passed");
+  return ok ? 0 : 1;
+}